@@ -79,6 +79,19 @@
 //Testing:
 #define FORCE_BUFFERED_MODE
 
+// Where POSIX is available, savefiles are memory-mapped when loading and fsync()'d when saving
+// (elsewhere they are read into memory in one go, and saving relies on fflush() alone):
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+#define POSIX_FILE_IO
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L // Must precede every #include for the POSIX declarations to be visible under strict ISO C.
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 /* Preprocessing Directives (#include) */
 #include <stdbool.h>
@@ -100,11 +113,51 @@
 #define MAX_ID ((MAX_COORDINATE + 1) * (MAX_COORDINATE + 1))
 #define NUM_LETTERS 26
 #define ALPHABET "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-#define MIN_DISPLAY_COMMAND_LENGTH 11
+#define MIN_DIMENSIONS_LENGTH 3 // "#x#"
 #define MIN_JUMP_COMMAND_LENGTH 10
 #define INT32_MAXIMUM_STRING STRINGIZE2(INT32_MAX)
 #define STRINGIZE2(x) STRINGIZE(x)
 #define STRINGIZE(x) #x
+#define NO_COORDINATE -1
+
+#define TILE_SIZE 64 // Rooms per side of a map tile (one bit per room in each uint64_t plane row)
+#define MIN_TILE_SLOTS 16 // Initial size of a map's tile directory (always a power of 2)
+#define MIN_TILES_PER_BLOCK 4 // Tiles in a map's first arena block (each later block doubles, up to the maximum)
+#define MAX_TILES_PER_BLOCK 1024
+#define TILE_PLANE_EXISTS 0x01
+#define TILE_PLANE_SOUTH 0x02
+#define TILE_PLANE_EAST 0x04
+#define TILE_PLANE_ALL (TILE_PLANE_EXISTS | TILE_PLANE_SOUTH | TILE_PLANE_EAST)
+
+#define SAVEFILE_EXTENSION ".ifmap"
+#define SAVEFILE_MAGIC "IFMP"
+#define SAVEFILE_VERSION 2
+#define SAVEFILE_PREAMBLE_SIZE 8 // Magic, then version and section count (uint16_t each)
+#define SAVEFILE_SECTION_ENTRY_SIZE 24 // Section type and CRC-32 (uint32_t each), then offset and length (uint64_t each)
+#define SAVEFILE_HEADER_SIZE (SAVEFILE_PREAMBLE_SIZE + NUM_SAVED_SECTIONS * SAVEFILE_SECTION_ENTRY_SIZE)
+#define NUM_SAVEFILE_SECTIONS 6
+#define NUM_SAVED_SECTIONS 5 // (Every section but one of the two map encodings)
+#define SAVEFILE_V1_HEADER_SIZE 12 // Map height, width and room count (int32_t each)
+#define SAVEFILE_V1_ROOM_SIZE 14 // Room y and x (int32_t each), then existence, four exits and mark (uint8_t each)
+#define SAVEFILE_V1_TRAILER_SIZE 33 // Display (4 int32_t), movement mode (uint8_t), max display size and cursor (4 int32_t)
+#define SAVEFILE_TEMPORARY_EXTENSION ".tmp" // Added to the savefile's name while it is being written
+#define SAVE_BUFFER_SIZE (1 << 20)
+#define RANGE_MODEL_BITS 11 // Precision of the range coder's adaptive probabilities
+#define RANGE_MODEL_ONE (1 << RANGE_MODEL_BITS)
+#define RANGE_MOVE_BITS 5 // How quickly the probabilities adapt (higher is slower)
+#define RANGE_TOP (1u << 24) // The range coder renormalizes (a byte at a time) whenever its range drops below this
+#define RUN_LENGTH_SLOT_BITS 6 // Enough to number the significant bits of any run length (at most 64)
+#define RUN_LENGTH_SLOTS (1 << RUN_LENGTH_SLOT_BITS)
+#define RUN_MODELED_MANTISSA_BITS 4 // Bits below a run length's leading 1 that get adaptive models (the rest are coded directly)
+#define JOURNAL_EXTENSION ".ifjournal" // Added to the savefile's name for the journal of edits made since it was saved
+#define JOURNAL_MAGIC "IFJN"
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 12 // Magic, then version and a reserved uint16_t, then the CRC-32 of the savefile's header
+#define JOURNAL_FRAME_CRC_SIZE 4
+#define JOURNAL_MIN_COMPACTION_SIZE (1 << 16) // A journal's records are never compacted into a snapshot below this many bytes
+#define NUM_JOURNAL_RECORDS 8
+#define MAX_JOURNAL_RECORD_VALUES 5
+#define MAX_VARINT_SIZE 5 // Bytes needed for any uint32_t at 7 bits per byte
 
 /* Type Definitions */
 enum cardinal_directions
@@ -115,38 +168,124 @@ enum cardinal_directions
     WEST,
 };
 
+enum savefile_sections
+{
+    MAP_SECTION,
+    MARKS_SECTION,
+    DISPLAY_SECTION,
+    SETTINGS_SECTION,
+    CURSOR_SECTION,
+    PACKED_MAP_SECTION,
+};
+
+enum journal_records // (Each record is its type, then its values as varints; see journal_record())
+{
+    JOURNAL_ROOM, // y, x, exists
+    JOURNAL_EXIT, // y, x, direction, open
+    JOURNAL_GROW, // rows north, columns east, rows south, columns west, blank
+    JOURNAL_SHRINK, // rows north, columns east, rows south, columns west
+    JOURNAL_CURSOR, // y, x
+    JOURNAL_MARKS, // start y, start x, end y, end x (each plus 1, so that 0 means unmarked)
+    JOURNAL_DISPLAY, // height, width, y_offset, x_offset
+    JOURNAL_SETTINGS, // movement mode, max display height, max display width
+};
+
 enum movement_mode
 {
     NESW,
     WASD,
 };
 
-typedef struct room
-{
-    int32_t y_coordinate;
-    int32_t x_coordinate;
-    bool exists;
-    bool exits[4];
-    struct room *next_room;
-    char mark;
-} Room;
-
 typedef struct dimensions
 {
     int32_t height;
     int32_t width;
 } Dimensions;
 
+typedef struct coordinates
+{
+    int32_t y_coordinate;
+    int32_t x_coordinate;
+} Coordinates;
+
+// A 64x64 block of world, allocated the first time anything in it is drawn (an unallocated tile has no rooms).
+// Each plane holds one bit per room, one uint64_t per row (bit x of row y is room (y, x) within the tile):
+typedef struct tile
+{
+    int64_t tile_y; // World row of the tile's top row, divided by TILE_SIZE
+    int64_t tile_x; // World column of the tile's left column, divided by TILE_SIZE
+    uint64_t exists[TILE_SIZE];
+    uint64_t south_edges[TILE_SIZE]; // Passage between the room and the room to its south
+    uint64_t east_edges[TILE_SIZE]; // Passage between the room and the room to its east
+    struct tile *next_free; // Next tile in the map's free list (only while the tile is unused)
+} Tile;
+
+// One of the large blocks a map's tiles are carved out of (see allocate_tile):
+typedef struct tile_block
+{
+    struct tile_block *next_block;
+    size_t capacity;
+    size_t used;
+    Tile tiles[]; // capacity tiles
+} Tile_Block;
+
 typedef struct map
 {
     int32_t height;
     int32_t width;
-    Room *root; // Pointer to start of linked list containing all rooms
+    // The map is a height x width window onto an unbounded world of tiles; moving its edges never moves any rooms:
+    int64_t y_origin; // World row holding map row 0
+    int64_t x_origin; // World column holding map column 0
+    Tile **tiles; // Tile directory: open-addressed hash table of allocated tiles (NULL for empty slots)
+    size_t tile_slots;
+    size_t tile_count;
+    Tile *last_tile; // Most recently found tile
+    // Arena holding every tile: tiles are carved out of a few large blocks and recycled through a free list,
+    // so the whole map is released with one free() per block:
+    Tile_Block *tile_blocks; // Newest block first
+    Tile *free_tiles;
+    struct journal *journal; // Where edits to the map are recorded (NULL while loading or replaying a journal)
 } Map;
 
+typedef struct save_buffer
+{
+    FILE *file;
+    unsigned char *bytes; // SAVE_BUFFER_SIZE bytes
+    size_t used;
+    uint64_t offset; // Bytes buffered so far in total (ie, the savefile offset of the next byte)
+    uint32_t crc; // CRC-32 of the bytes buffered since this was last reset to 0
+    uint64_t pending_bits; // Bits not yet making up a whole uint64_t (see buffer_bits())
+    int pending_count;
+    bool failed; // Set once any write to the file fails (later writes are skipped)
+} Save_Buffer;
+
+typedef struct range_encoder
+{
+    Save_Buffer *b;
+    uint64_t low;
+    uint32_t range;
+    unsigned char cache; // The last byte held back (in case a carry reaches it)...
+    uint64_t cache_size; // ...plus the number of 0xFF bytes held back after it
+} Range_Encoder;
+
+typedef struct range_decoder
+{
+    const unsigned char *next;
+    const unsigned char *end;
+    uint32_t range;
+    uint32_t code;
+    bool overrun; // Set if decoding ran past the end of the coded bytes
+} Range_Decoder;
+
+typedef struct run_models // Adaptive probabilities for coding a map's planes as runs, per plane and per run value
+{
+    uint16_t first_bit[3];
+    uint16_t length_bits[3][2][RUN_LENGTH_SLOTS];
+    uint16_t mantissa[3][2][RUN_LENGTH_SLOTS][1 << RUN_MODELED_MANTISSA_BITS];
+} Run_Models;
+
 typedef struct display
 {
-    Room ***layout;
     int height;
     int width;
     int32_t y_offset;
@@ -166,17 +305,42 @@ typedef struct settings
     int max_display_width;
 } Settings;
 
+// The edits made since the map was last saved, as recorded in its journal file. The journal starts either from the
+// savefile itself (identified by the CRC-32 of its header, which holds every section's CRC) or from a snapshot at the
+// start of the journal file, and goes on with one frame per command: the frame's length (a varint), its records,
+// then their CRC-32 (so that a frame torn by a crash is ignored).
+typedef struct journal
+{
+    FILE *file; // NULL until the first edit after a load, save or compaction
+    char *path;
+    bool based_on_savefile; // Whether the journal starts from the savefile (else from a snapshot of its own)
+    uint32_t savefile_crc;
+    uint64_t base_size; // Size of whatever the journal starts from
+    uint64_t size; // Bytes of frames written since then
+    bool failed; // Set if the journal can't be written (journaling then stops until the next save)
+    unsigned char *pending; // Records of the current command's edits
+    size_t pending_used;
+    size_t pending_capacity;
+    // The view as of the last record, so that only its changes need recording:
+    Coordinates cursor;
+    Coordinates start;
+    Coordinates end;
+    Display display;
+    Settings settings;
+} Journal;
+
 typedef struct gamestate
 {
     bool quit;
     bool saved;
     Display *display;
-    Room *current_cursor_focus;
+    Coordinates current_cursor_focus;
     Map *current_map;
     Settings *user_settings;
-    Room *start;
-    Room *end;
+    Coordinates start; // NO_ROOM if no room is marked as the start
+    Coordinates end; // NO_ROOM if no room is marked as the end
     char *current_filename;
+    Journal journal;
 } Gamestate;
 
 /* Declarations of External Variables */
@@ -184,18 +348,72 @@ typedef struct gamestate
 
 /* Declarations of Global Variables */
 int error_code = 0;
+const Coordinates NO_ROOM = {NO_COORDINATE, NO_COORDINATE};
 
 /* Prototypes for non-main functions */
 void gobble_line(void);
 Dimensions prompt_for_dimensions(void);
 Map *create_map(Dimensions dim);
-Room *make_room(int32_t y_coordinate, int32_t x_coordinate);
-Map *load_map(long *fread_offset, char **file_to_load);
-Gamestate *load_gamestate(long *fread_offset, char **file_to_load);
+int64_t tile_coordinate(int64_t world_coordinate, int *offset);
+size_t tile_slot(Map *m, int64_t tile_y, int64_t tile_x);
+void place_tile(Map *m, Tile *t);
+Tile *find_tile(Map *m, int64_t tile_y, int64_t tile_x);
+Tile *touch_tile(Map *m, int64_t tile_y, int64_t tile_x);
+Tile *allocate_tile(Map *m);
+void release_tile(Map *m, Tile *t);
+bool tile_is_empty(Tile *t);
+Tile *room_tile(Map *m, int32_t y_coordinate, int32_t x_coordinate, bool allocate, int *row, uint64_t *bit);
+bool room_exists(Map *m, int32_t y_coordinate, int32_t x_coordinate);
+void set_room_exists(Map *m, int32_t y_coordinate, int32_t x_coordinate, bool exists);
+bool cursor_room_exists(Gamestate *g);
+void set_cursor_room_exists(Gamestate *g, bool exists);
+char room_mark(Gamestate *g, Coordinates room);
+bool same_room(Coordinates a, Coordinates b);
+uint64_t *edge_word(Map *m, int32_t y_coordinate, int32_t x_coordinate, int direction, bool allocate, uint64_t *bit);
+bool edge_in_map(Map *m, int32_t y_coordinate, int32_t x_coordinate, int direction);
+bool room_exit(Map *m, int32_t y_coordinate, int32_t x_coordinate, int direction);
+void set_room_exit(Map *m, int32_t y_coordinate, int32_t x_coordinate, int direction, bool open);
+bool cursor_exit(Gamestate *g, int direction);
+void set_cursor_exit(Gamestate *g, int direction, bool open);
+void edit_tile(Tile *t, int64_t world_top, int64_t world_left, int64_t world_bottom, int64_t world_right, int planes, bool fill);
+void edit_region(Map *m, int32_t top, int32_t left, int32_t rows, int32_t columns, int planes, bool fill);
+void grow_map(Map *m, int32_t rows_north, int32_t columns_east, int32_t rows_south, int32_t columns_west, bool blank);
+void shrink_map(Map *m, int32_t rows_north, int32_t columns_east, int32_t rows_south, int32_t columns_west);
+void shift_marks(Gamestate *g, int32_t y_shift, int32_t x_shift);
+void unmark_outside_map(Gamestate *g);
+Gamestate *load_gamestate(void);
+const char *read_savefile(Gamestate *g);
+const char *read_whole_file(FILE *file, unsigned char **image, size_t *length);
+char *savefile_path(char *filename, const char *extension, bool temporary);
+const char *decode_savefile(Gamestate *g, const unsigned char *image, size_t length);
+const char *decode_savefile_v1(Gamestate *g, const unsigned char *image, size_t length);
+const char *decode_savefile_v2(Gamestate *g, const unsigned char *image, size_t length);
+const char *check_saved_view(int32_t height, int32_t width, Display *d, Settings *s, Coordinates cursor);
+const char *install_loaded_state(Gamestate *g, Map *m, Display *d, Settings *s, Coordinates cursor, Coordinates start, Coordinates end);
+int32_t read_int32(const unsigned char *bytes);
+uint16_t read_le16(const unsigned char *bytes);
+uint32_t read_le32(const unsigned char *bytes);
+uint64_t read_le64(const unsigned char *bytes);
+void write_le16(unsigned char *bytes, uint16_t value);
+void write_le32(unsigned char *bytes, uint32_t value);
+void write_le64(unsigned char *bytes, uint64_t value);
+uint64_t read_bits(const unsigned char *bytes, uint64_t first_bit, int count);
+uint32_t crc32_update(uint32_t crc, const unsigned char *bytes, size_t count);
+uint64_t decode_run(Range_Decoder *d, Run_Models *models, int plane, int value);
+void start_range_decoder(Range_Decoder *d, const unsigned char *bytes, size_t length);
+int decode_bit(Range_Decoder *d, uint16_t *probability);
+int decode_direct_bit(Range_Decoder *d);
+unsigned char next_coded_byte(Range_Decoder *d);
+bool set_plane_bits(Map *m, int plane, uint64_t first_bit, uint64_t count);
+int count_trailing_zeros(uint64_t bits);
+int count_leading_zeros(uint64_t bits);
+bool merge_tile_row(Map *m, int64_t tile_y, int64_t tile_x, int row, int plane, uint64_t bits);
+bool recover_journal(Gamestate *g);
+size_t savefile_v2_length(const unsigned char *image, size_t length);
+bool replay_journal_frame(Gamestate *g, const unsigned char *bytes, size_t length);
+bool read_varint(const unsigned char **next, const unsigned char *end, uint32_t *value);
 Map *edit_map(Map *editable_map, Gamestate *current_gamestate);
-Room ***create_initial_layout(Map *map_to_display);
-void free_layout(Room ***layout, int32_t height);
-Display *initialize_display(Room ***layout_array, int32_t array_height, int32_t array_width, Room *root);
+Display *initialize_display(int32_t map_height, int32_t map_width);
 Settings *initialize_settings(void);
 Gamestate *initialize_gamestate(Display *display, Map *current_map, Settings *defaults);
 void print_display(Gamestate *g);
@@ -207,8 +425,11 @@ int get_command(char *prompt, Gamestate *g, char mode);
 void free_command(Command_C *root);
 int parse_command(char *command, Gamestate *g);
 int caseless_strcmp(char *str1, char *str2);
-int display_strcmp(char *command, int32_t *user_display_rows, int32_t *user_display_columns);
+int dimensions_strcmp(char *command, char *needed_start, int32_t *user_rows, int32_t *user_columns);
 int handle_display_command(Gamestate *g, int32_t user_rows, int32_t user_columns);
+int handle_resize_command(Gamestate *g, int32_t user_rows, int32_t user_columns, bool blank);
+int add_strcmp(char *command, char *needed_start, int32_t *count, int *direction);
+int handle_add_command(Gamestate *g, int32_t count, int direction, bool blank);
 int jump_strcmp(char *command, char **letter_coordinate, char **number_coordinate);
 int handle_jump_command(Gamestate *g, char *letter_coordinate, char *number_coordinate);
 int32_t convert_letters_to_numbers(char *letter_coordinate);
@@ -220,19 +441,45 @@ void add_row_north(Gamestate *g);
 void add_column_east(Gamestate *g);
 void add_row_south(Gamestate *g);
 void add_column_west(Gamestate *g);
+void add_rows_and_columns(Gamestate *g, int32_t rows_north, int32_t columns_east, int32_t rows_south, int32_t columns_west, bool blank);
 void toggle_movement(Gamestate *g);
 void mark(char mark, Gamestate *g);
 void delete(Gamestate *g);
 void undelete(Gamestate *g);
-void open(Gamestate *g, int direction);
-void close(Gamestate *g, int direction);
+void open_exit(Gamestate *g, int direction);
+void close_exit(Gamestate *g, int direction);
 void remove_row_north(Gamestate *g);
 void remove_column_east(Gamestate *g);
 void remove_row_south(Gamestate *g);
 void remove_column_west(Gamestate *g);
 void save_gamestate(Gamestate *savable_gamestate);
+int write_savefile(Gamestate *g, const char *path, const char *temporary_path, bool compress, uint32_t *header_crc, uint64_t *length);
+uint32_t encode_savefile(Gamestate *g, Save_Buffer *b, bool compress);
+void encode_map_section(Map *m, Save_Buffer *b);
+void encode_packed_map_section(Map *m, Save_Buffer *b);
+void initialize_run_models(Run_Models *models);
+void encode_run(Range_Encoder *e, Run_Models *models, int plane, int value, uint64_t length);
+void encode_bit(Range_Encoder *e, uint16_t *probability, int bit);
+void encode_direct_bits(Range_Encoder *e, uint64_t bits, int count);
+void shift_low(Range_Encoder *e);
+void flush_range_encoder(Range_Encoder *e);
+void journal_record(Journal *j, int type, const uint32_t *values, int count);
+size_t write_varint(unsigned char *bytes, uint32_t value);
+void journal_view(Gamestate *g);
+void remember_journal_view(Gamestate *g);
+void journal_command(Gamestate *g);
+void compact_journal(Gamestate *g);
+void rebase_journal(Gamestate *g, bool based_on_savefile, uint32_t savefile_crc, uint64_t base_size);
+void abandon_journal(Journal *j);
+void discard_journal(Journal *j);
+void close_journal(Journal *j);
+uint64_t plane_row(Map *m, int64_t world_y, int64_t tile_x, int plane);
+void flush_save_buffer(Save_Buffer *b);
+void buffer_bytes(Save_Buffer *b, const unsigned char *bytes, size_t count);
+void buffer_int32(Save_Buffer *b, int32_t value);
+void buffer_bits(Save_Buffer *b, uint64_t bits, int count);
+void end_buffered_bits(Save_Buffer *b);
 void free_map(Map *freeable_map);
-void free_rooms(Room *r);
 void free_gamestate(Gamestate *g);
 bool warn(Gamestate *g);
 
@@ -248,13 +495,6 @@ bool warn(Gamestate *g);
  *****************************************************************************************/
 int main(void)
 {
-    // Loading is done in two variably sized, unequal parts.
-    // This variable allows tracking of where first part ends so second part knows where to begin.
-    // (This was a consequence of the greenness of the programmer when originally structuring the program.)
-    long load_cursor = 0;
-    // This variable allows tracking of loaded filename until the gamestate is loaded (for the same reason).
-    char *file_to_load = NULL;
-
     // Main menu:
     // Option: Create new map to edit
     // Option: Load existing map to edit
@@ -287,7 +527,14 @@ int main(void)
         switch (selection)
         {
             case 1: free_map(edit_map(create_map(prompt_for_dimensions()), NULL)); break;
-            case 2: free_map(edit_map(load_map(&load_cursor, &file_to_load), load_gamestate(&load_cursor, &file_to_load))); break;
+            case 2:
+            {
+                // The loaded gamestate carries its own map (if the user backs out instead, there is nothing to edit):
+                Gamestate *loaded_gamestate = load_gamestate();
+                if (loaded_gamestate != NULL)
+                    free_map(edit_map(loaded_gamestate->current_map, loaded_gamestate));
+                break;
+            }
             default: goto quit;
         }
         if (error_code) break;
@@ -327,6 +574,11 @@ int main(void)
         case 27: (void) printf("Encountered error. Error code 27: Failed to properly write to savefile.\n"); break;
         case 28: (void) printf("Encountered error. Error code 28: Failed to properly close savefile.\n"); break;
         case 29: (void) printf("Encountered error. Error code 29: Failed both to properly write to savefile and to properly close savefile.\n"); break;
+        case 30: (void) printf("Encountered error. Error code 30: Unable to allocate memory for the name of a savefile.\n"); break;
+        case 31: (void) printf("Encountered error. Error code 31: Unable to allocate memory for the contents of the file to load.\n"); break;
+        case 32: (void) printf("Encountered error. Error code 32: Unable to allocate memory for the save buffer.\n"); break;
+        case 33: (void) printf("Encountered error. Error code 33: Failed to replace the savefile with the newly written one (which was left under the same name plus \"" SAVEFILE_TEMPORARY_EXTENSION "\").\n"); break;
+        case 34: (void) printf("Encountered error. Error code 34: Unable to allocate memory for the edit journal.\n"); break;
     }
     return error_code;
 }
@@ -403,366 +655,1740 @@ Map *create_map(Dimensions dim)
         return NULL;
     }
 
-    created_map->height = dim.height;
-    created_map->width = dim.width;
-
-    // Initialize linked list of rooms, starting from (0,0):
-    created_map->root = NULL;
-    for (int32_t y = 0; y < created_map->height; y++)
+    // Start from an empty map at the world origin (no tiles, so no rooms), then grow it to size:
+    created_map->height = created_map->width = 0;
+    created_map->y_origin = created_map->x_origin = 0;
+    created_map->tile_slots = MIN_TILE_SLOTS;
+    created_map->tile_count = 0;
+    created_map->last_tile = NULL;
+    created_map->tile_blocks = NULL;
+    created_map->free_tiles = NULL;
+    created_map->journal = NULL;
+    created_map->tiles = calloc(created_map->tile_slots, sizeof(Tile *));
+    if (created_map->tiles == NULL)
     {
-        for (int32_t x = 0; x < created_map->width; x++)
-        {
-            Room *r = make_room(y, x);
-            if (error_code) return created_map;
-            if (created_map->root == NULL)
-            {
-                created_map->root = r;
-            }
-            else
-            {
-                Room *attach_point = created_map->root;
-                while (attach_point->next_room != NULL)
-                {
-                    attach_point = attach_point->next_room;
-                }
-                attach_point->next_room = r;
-            }
-        }
+        error_code = 5;
+        return created_map;
     }
+
+    grow_map(created_map, 0, dim.width, dim.height, 0, false);
     return created_map;
 }
 
 /*********************************************************************************************
- * make_room:    Purpose: Allocates memory for and initializes single room.                  *
- *               Parameters: int32_t y_coordinate -> the y-coordinate to assign to the room  *
- *                           int32_t x_coordinate -> the x-coordinate to assign to the room  *
- *               Return value: Room * -> a pointer to the new room                           *
- *               Side effects: - Allocates memory.                                           *
- *                             - Edits global variable "error_code".                         *
+ * tile_coordinate:    Purpose: Splits a world coordinate into the coordinate of the tile    *
+ *                              containing it and its offset within that tile (rounding      *
+ *                              down, so that negative world coordinates work too).          *
+ *                     Parameters: int64_t world_coordinate -> the coordinate to split       *
+ *                                 int *offset -> receives the offset within the tile        *
+ *                     Return value: int64_t -> the tile coordinate                          *
+ *                     Side effects: none                                                    *
  *********************************************************************************************/
-Room *make_room(int32_t y_coordinate, int32_t x_coordinate)
+int64_t tile_coordinate(int64_t world_coordinate, int *offset)
 {
-    Room *r = malloc(sizeof(Room));
-    if (r == NULL)
-    {
-        error_code = 5;
-        return NULL;
-    }
-
-    r->y_coordinate = y_coordinate, r->x_coordinate = x_coordinate;
-    r->exists = true, r->next_room = NULL;
-    for (int cardinal_direction = NORTH; cardinal_direction < NUM_CARDINAL_DIRECTIONS; cardinal_direction++)
-    {
-        r->exits[cardinal_direction] = 0;
-    }
-    r->mark = 0;
-
-    return r;
+    int64_t tile = world_coordinate >= 0 ? world_coordinate / TILE_SIZE : -((-world_coordinate - 1) / TILE_SIZE) - 1;
+    *offset = (int) (world_coordinate - tile * TILE_SIZE);
+    return tile;
 }
 
-/*****************************************************************************************
- * load_map:    Purpose: Loads map from file for further editing.                        *
- *              Parameters: none                                                         *
- *              Return value: Map * -> The loaded map, to be passed into editing.        *
- *              Side effects: - Reads from external files.                               *
- *                            - Prints to stdout.                                        *
- *                            - Reads from stdin.                                        *
- *                            - Allocates memory.                                        *
- *****************************************************************************************/
-Map *load_map(long *fread_offset, char **file_to_load)
+/*********************************************************************************************
+ * find_tile, touch_tile:    Purpose: Look up the tile at the given tile coordinates in the  *
+ *                                    map's tile directory (an open-addressed hash table).   *
+ *                                    touch_tile allocates the tile (with no rooms and no    *
+ *                                    passages) if it doesn't exist yet.                     *
+ *                           Parameters: Map *m -> the map to search                         *
+ *                                       int64_t tile_y, tile_x -> the tile coordinates      *
+ *                           Return value: Tile * -> the tile (NULL if not found/allocated)  *
+ *                           Side effects: - (touch_tile only) May allocate memory.          *
+ *                                         - (touch_tile only) Edits global "error_code"     *
+ *********************************************************************************************/
+size_t tile_slot(Map *m, int64_t tile_y, int64_t tile_x)
 {
-    //TODO
-    //  ...as part of the function, perform validation on the map file (for example, that it hasn't been edited so as to expand past MAX_COORDINATE, etc)
-    // This function will need to run malloc for maps & rooms, or use the constructor subroutines and then re-assign properties from the loaded file to the malloc'd variables.
-
-    //According to the C standard (C90 §6.3.2.2, C99 §6.5.2.2), the order in which function arguments are evaluated is unspecified.
-    //Therefore, it can't be certain whether load_gamestate() or load_map() will run first,
-    //meaning the user might have already specified which file to load during load_gamestate().
-    if (*file_to_load == NULL)
-    {
-    }
+    uint64_t hash = (uint64_t) tile_y * 0x9E3779B97F4A7C15u ^ (uint64_t) tile_x * 0xC2B2AE3D27D4EB4Fu;
+    return (size_t) (hash ^ (hash >> 32)) & (m->tile_slots - 1);
+}
 
-    Map *loaded_map = NULL;
-    return loaded_map;
+void place_tile(Map *m, Tile *t)
+{
+    size_t i = tile_slot(m, t->tile_y, t->tile_x);
+    while (m->tiles[i] != NULL)
+        i = (i + 1) & (m->tile_slots - 1);
+    m->tiles[i] = t;
+    return;
 }
 
-Gamestate *load_gamestate(long *fread_offset, char **file_to_load)
+Tile *find_tile(Map *m, int64_t tile_y, int64_t tile_x)
 {
-    //TODO
-    // as part of the function, perform validation on the gameplay file (if that makes sense when the time comes)
-    // This function will need to run malloc for display & layout & gamestate, or use the constructor subroutines and then re-assign properties from the loaded file to the malloc'd variables.
+    // Consecutive lookups (eg, along a display row) usually land in the same tile:
+    if (m->last_tile != NULL && m->last_tile->tile_y == tile_y && m->last_tile->tile_x == tile_x)
+        return m->last_tile;
 
-    //According to the C standard (C90 §6.3.2.2, C99 §6.5.2.2), the order in which function arguments are evaluated is unspecified.
-    //Therefore, it can't be certain whether load_gamestate() or load_map() will run first,
-    //meaning fread_offset might not have been altered appropriately yet.
-    if (*fread_offset == 0)
-    {
-    }
-    if (*file_to_load == NULL)
+    for (size_t i = tile_slot(m, tile_y, tile_x); m->tiles[i] != NULL; i = (i + 1) & (m->tile_slots - 1))
     {
+        if (m->tiles[i]->tile_y == tile_y && m->tiles[i]->tile_x == tile_x)
+            return m->last_tile = m->tiles[i];
     }
-
-    // ERASE ".ifmap" FROM END OF FILENAME BEFORE STORING IN LOADED_GAMESTATE->CURRENT_FILENAME!
-
-    Gamestate *loaded_gamestate = NULL;
-    return loaded_gamestate;
+    return NULL;
 }
 
-/********************************************************************************************
- * edit_map:    Purpose: The bulk of the program. Allows the user to edit the passed map.   *
- *              Parameters: Map *editable_map -> the map to be edited.                      *
- *              Return value: Map * -> the now-edited map,                                  *
- *                                     to be freed before further program operation         *
- *                                     or program termination.                              *
- *              Side effects: - Clears screen and scrollback                                *
- *                            - Calls save_gamestate, which edits external files.                 *
- *                            - Prints to stdout.                                           *
- *                            - Reads from stdin.                                           *
- *                            - Modifies any and all data associated with passed map.       *
- ********************************************************************************************/
-Map *edit_map(Map *editable_map, Gamestate *current_gamestate)
+Tile *touch_tile(Map *m, int64_t tile_y, int64_t tile_x)
 {
-    if (error_code) return editable_map;
-
-    Gamestate *gamestate;
+    Tile *t = find_tile(m, tile_y, tile_x);
+    if (t != NULL)
+        return t;
 
-    if (current_gamestate == NULL) // If starting a new map, not loading one:
+    // Keep the directory at most half full, doubling it as needed:
+    if ((m->tile_count + 1) * 2 > m->tile_slots)
     {
-        // Temp variables used for initialization purposes only:
-        Room ***layout;
-        Display *display;
-        Settings *settings;
-
-        // Create layout, display, and gamestate:
-        layout = create_initial_layout(editable_map);
-        if (error_code)
-        {
-            free_layout(layout, editable_map->height);
-            return editable_map;
-        }
-
-        display = initialize_display(layout, editable_map->height, editable_map->width, editable_map->root);
-        if (error_code)
-        {
-            free_layout(layout, editable_map->height);
-            return editable_map;
-        }
-
-        settings = initialize_settings();
-        if (error_code)
+        Tile **old_tiles = m->tiles;
+        size_t old_slots = m->tile_slots;
+        Tile **new_tiles = calloc(old_slots * 2, sizeof(Tile *));
+        if (new_tiles == NULL)
         {
-            free_layout(layout, editable_map->height);
-            free(display);
+            error_code = 5;
+            return NULL;
         }
-
-        gamestate = initialize_gamestate(display, editable_map, settings);
-        if (error_code)
+        m->tiles = new_tiles, m->tile_slots = old_slots * 2;
+        for (size_t i = 0; i < old_slots; i++)
         {
-            free_layout(layout, editable_map->height);
-            free(display);
-            free(settings);
+            if (old_tiles[i] != NULL)
+                place_tile(m, old_tiles[i]);
         }
-        // Now that gamestate has been created & initialized, the layout/display/editable_map variables will no longer be used.
-        // For memory-management reasons, all access to displays/layouts/maps will be accomplished only via the gamestate structure.
-        // Otherwise, when new layouts/maps are created/destroyed during the course of subroutines, these old variables will still contain the
-        // *old* pointer addresses rather than the various newly-created/updated ones. Free()-ing is much easier if I can free everything via
-        // the gamestate variable instead. (The map is a special case, as the structure of the main menu requires the map to be passed to a
-        // free()-ing subroutine *after* this edit_map subroutine returns, so I will simply re-assign the editable_map variable to the newest
-        // map via gamestate just before freeing gamestate and returning editable_map. This weirdness is simply a consequence of my never having
-        // built a program this complex before; in future programs with similar goals, I will likely try to center all the structure around a
-        // gamestate from the very start, instead of centering around, say, a map, as here.)
-    }
-    else // If continuing a loaded file:
-    {
-        gamestate = current_gamestate;
+        free(old_tiles);
     }
 
-    // Interaction Loop:
-    for (;!gamestate->quit;)
-    {
-        CLEAR_CONSOLE;
+    t = allocate_tile(m);
+    if (t == NULL)
+        return NULL;
+    t->tile_y = tile_y, t->tile_x = tile_x;
+    place_tile(m, t);
+    m->tile_count++;
+    return m->last_tile = t;
+}
 
-        // Print display:
-        print_display(gamestate);
-        if (error_code)
+/*********************************************************************************************
+ * allocate_tile:    Purpose: Takes a blank tile from the map's arena: a recycled one if any *
+ *                            are free, else the next unused tile of the newest block        *
+ *                            (adding a block, twice the size of the last, when it's full).  *
+ *                   Parameters: Map *m -> the map to allocate for                           *
+ *                   Return value: Tile * -> the tile (NULL on failure)                      *
+ *                   Side effects: - May allocate memory.                                    *
+ *                                 - Edits global variable "error_code"                      *
+ *********************************************************************************************/
+Tile *allocate_tile(Map *m)
+{
+    Tile *t = m->free_tiles;
+    if (t != NULL)
+        m->free_tiles = t->next_free;
+    else
+    {
+        Tile_Block *block = m->tile_blocks;
+        if (block == NULL || block->used == block->capacity)
         {
-            free_layout(gamestate->display->layout, gamestate->current_map->height);
-            free(gamestate->display);
-            free(gamestate->user_settings);
-            editable_map = gamestate->current_map; // Re-establish map as its own variable so as to return and free it even once gamestate is already freed.
-            free_gamestate(gamestate);
-            return editable_map;
-        }
-
-        #ifdef FORCE_BUFFERED_MODE
-            obey_command(get_command("Enter command:\n>", gamestate, 'c'), gamestate);
-            if (error_code)
+            size_t capacity = block == NULL ? MIN_TILES_PER_BLOCK : block->capacity * 2 > MAX_TILES_PER_BLOCK ? MAX_TILES_PER_BLOCK : block->capacity * 2;
+            block = malloc(sizeof(Tile_Block) + sizeof(Tile) * capacity);
+            if (block == NULL)
             {
-                free_layout(gamestate->display->layout, gamestate->current_map->height);
-                free(gamestate->display);
-                free(gamestate->user_settings);
-                editable_map = gamestate->current_map; // Re-establish map as its own variable so as to return and free it even once gamestate is already freed.
-                free_gamestate(gamestate);
-                return editable_map;
+                error_code = 5;
+                return NULL;
             }
-            if (gamestate->quit && !gamestate->saved)
-                if (warn(gamestate))
-                    save_gamestate(gamestate);
-        #endif
-        #ifdef UNIX
-            //TODO
-        #endif
-        #ifdef WINDOWS
-            //TODO
-        #endif
-
-
-        // TODO: Print command prompt (incl "help for help")
-        // TODO: Accept input
-        // TODO: Parse user command
-        // TODO: Update program state based on command
-        // TODO: Update display based on updated state.
-        // TODO: Add save/quit functionality.
+            block->capacity = capacity, block->used = 0;
+            block->next_block = m->tile_blocks;
+            m->tile_blocks = block;
+        }
+        t = &block->tiles[block->used++];
     }
 
-    // Prompt for cursor start location (represented by *)
-    //  Alternately, start cursor on top line, furthest room to left.
-    // Allow commands for moving cursor cardinally ("move up")
-    // Allow commands for moving cursor cardinally while skipping over non-existent rooms ("skip up")
-    // Allow commands for cursor jumping ("jump to A3")
-    // Allow commands for establishing connecting doors between rooms (cardinally)
-    //      ...for now, force exit matching (eg, adding a north exit to a lower room forces a south exit to be added to the room above).
-    //        ...one day, this could be refactored to allow "warping" exits, but it'd probably be better to add that functionality w/ a proper GUI.
-    // Allow commands for removing connections
-    //      ...force destruction of matching exit (eg, removing a north exit forces removal of south exit from room above)
-    // Allow commands for expanding grid by x rows or columns
-    //      ...but ensure that this never expands past the MAX_COORDINATE limit.
-    // Allow commands for expanding grid by adding new individual rooms
-    //      ...but ensure that this never expands past the MAX_COORDINATE limit.
-    // Allow commands for deleting individual rooms
-    //      ...but ensure the row/column count stays above zero
-    // Allow commands for retracting grid by subtracting x rows or columns
-    //      ...but ensure the row/column count stays above zero
-    // Allow commands for establishing entrances and exits to maze (including interior ones)
-    // Allow commands for scrolling view of grid cardinally (in this case, meaning up, down, left, right)
-    // Let attempts at moving the cursor past the edges of the grid cause the grid to scroll (if there are rooms in that direction).
-    // Allow commands for saving maze to file and reading maze from file
-    // Allow commands for translating entire map plus or minus x x-values or y y-values
-    // Allow commands to establish critical path (in separate ANSI color)
-    // Allow command to highlight which rooms cannot be reached
-    // Allow command to determine whether critical path exists
-
-
-    //TODO: Allow saving map before returning (returning leads to freeing--aka losing--map from memory)
-    //TODO: Warns when about to return without saving
-    free_layout(gamestate->display->layout, gamestate->current_map->height);
-    free(gamestate->display);
-    free(gamestate->user_settings);
-    editable_map = gamestate->current_map; // Re-establish map as its own variable so as to return and free it even once gamestate is already freed.
-    free_gamestate(gamestate);
-    return editable_map;
+    (void) memset(t, 0, sizeof(Tile));
+    return t;
 }
 
-/**********************************************************************************************************
- * create_initial_layout:     Purpose: Allocates room for, and initializes,                               *
- *                                     a 2D array containing the addresses of rooms to display            *
- *                                     as visualized map during editing.                                  *
- *                            Parameters: Map *map_to_display -> the map data to create the array from.   *
- *                            Return value: Room *** -> a pointer to the array                            *
- *                            Side effects: - allocates memory                                            *
- *                                          - edits global variable "error_code"                          *
- **********************************************************************************************************/
-Room ***create_initial_layout(Map *map_to_display)
+/*********************************************************************************************
+ * release_tile:    Purpose: Removes the given (empty) tile from the map's tile directory    *
+ *                           and returns it to the arena's free list. Later tiles in the     *
+ *                           same probe run are shifted back so lookups never stop early     *
+ *                           (so a caller walking the directory should re-check the slot).   *
+ *                  Parameters: Map *m -> the map containing the tile                        *
+ *                              Tile *t -> the tile to release                               *
+ *                  Return value: none                                                       *
+ *                  Side effects: - Edits the map's tile directory and free list.            *
+ *********************************************************************************************/
+void release_tile(Map *m, Tile *t)
 {
-    //Create 2D grid to store rooms:
-    int32_t ncols = map_to_display->width;
-    int32_t nrows = map_to_display->height;
-
-    Room ***layout = malloc(sizeof(Room **) * nrows);
-    if (layout == NULL)
-    {
-        error_code = 2;
-        return NULL;
-    }
-
-    for (int32_t i = 0; i < nrows; i++)
+    size_t mask = m->tile_slots - 1, hole = tile_slot(m, t->tile_y, t->tile_x);
+    while (m->tiles[hole] != t)
+        hole = (hole + 1) & mask;
+
+    if (m->last_tile == t)
+        m->last_tile = NULL;
+    t->next_free = m->free_tiles;
+    m->free_tiles = t;
+    m->tile_count--;
+
+    m->tiles[hole] = NULL;
+    for (size_t i = (hole + 1) & mask; m->tiles[i] != NULL; i = (i + 1) & mask)
     {
-        layout[i] = malloc(sizeof(Room *) * (ncols));
-        if (layout[i] == NULL)
+        // Move this tile into the hole unless its home slot lies (cyclically) after the hole:
+        size_t home = tile_slot(m, m->tiles[i]->tile_y, m->tiles[i]->tile_x);
+        if (((i - home) & mask) >= ((i - hole) & mask))
         {
-            error_code = 3;
-            return NULL;
+            m->tiles[hole] = m->tiles[i];
+            m->tiles[i] = NULL;
+            hole = i;
         }
     }
+    return;
+}
 
-    for (int32_t y = 0; y < nrows; y++)
-    {
-        for (int32_t x = 0; x < ncols; x++)
-        {
-            Room *current = map_to_display->root;
-            while (current != NULL)
-            {
-                if (current->y_coordinate == y && current->x_coordinate == x)
-                {
-                    layout[y][x] = current;
-                    break;
-                }
-                current = current->next_room;
-            }
-        }
-    }
+bool tile_is_empty(Tile *t)
+{
+    uint64_t any = 0;
+    for (int row = 0; row < TILE_SIZE; row++)
+        any |= t->exists[row] | t->south_edges[row] | t->east_edges[row];
+    return any == 0;
+}
 
-    return layout;
+/*********************************************************************************************
+ * room_tile:    Purpose: Finds the tile holding the given room, along with the room's row   *
+ *                        within the tile and its bit within that row of each plane.         *
+ *               Parameters: Map *m -> the map containing the room                           *
+ *                           int32_t y_coordinate, x_coordinate -> the room                  *
+ *                           bool allocate -> whether to allocate the tile if it is missing  *
+ *                           int *row -> receives the room's row within the tile             *
+ *                           uint64_t *bit -> receives the room's bit within the row         *
+ *               Return value: Tile * -> the tile (NULL if it isn't allocated)               *
+ *               Side effects: - (if allocating) May allocate memory.                        *
+ *                             - (if allocating) Edits global variable "error_code"          *
+ *********************************************************************************************/
+Tile *room_tile(Map *m, int32_t y_coordinate, int32_t x_coordinate, bool allocate, int *row, uint64_t *bit)
+{
+    int column;
+    int64_t tile_y = tile_coordinate(m->y_origin + y_coordinate, row);
+    int64_t tile_x = tile_coordinate(m->x_origin + x_coordinate, &column);
+    *bit = (uint64_t) 1 << column;
+    return allocate ? touch_tile(m, tile_y, tile_x) : find_tile(m, tile_y, tile_x);
 }
 
-/****************************************************************************************************
- * free_layout:    Purpose: Frees all rows in layout, followed by layout.                           *
- *                 Parameters: - Room ***layout -> the layout to be freed                       *
- *                             - int32_t height -> the number of rows in the layout                 *
- *                 Return value: none                                                               *
- *                 Side effects: - Frees all memory associated with given layout. Cannot be undone. *
- ****************************************************************************************************/
-void free_layout(Room ***layout, int32_t height)
+/*********************************************************************************************
+ * room_exists, set_room_exists:                                                             *
+ *               Purpose: Read/write whether the given room exists.                          *
+ *                        Rooms in unallocated tiles don't exist; deleting one of them       *
+ *                        therefore never needs to allocate anything.                        *
+ *               Parameters: Map *m -> the map containing the room                           *
+ *                           int32_t y_coordinate, x_coordinate -> the room                  *
+ *                           bool exists -> (set_room_exists only) the new state of the room *
+ *               Return value: (room_exists only) bool -> whether the room exists            *
+ *               Side effects: - (set_room_exists only) Edits the map (may allocate a tile). *
+ *                             - (set_room_exists only) Records any change in the journal.   *
+ *                             - (set_room_exists only) Edits global variable "error_code"   *
+ *********************************************************************************************/
+bool room_exists(Map *m, int32_t y_coordinate, int32_t x_coordinate)
 {
-    for (int32_t y = 0; y < height; y++)
-    {
-        free(layout[y]);
-    }
+    int row;
+    uint64_t bit;
+    Tile *t = room_tile(m, y_coordinate, x_coordinate, false, &row, &bit);
+    return t != NULL && (t->exists[row] & bit);
+}
 
-    free(layout);
+void set_room_exists(Map *m, int32_t y_coordinate, int32_t x_coordinate, bool exists)
+{
+    int row;
+    uint64_t bit;
+    Tile *t = room_tile(m, y_coordinate, x_coordinate, exists, &row, &bit);
+    if (t == NULL)
+        return;
+    if (m->journal != NULL && ((t->exists[row] & bit) != 0) != exists)
+        journal_record(m->journal, JOURNAL_ROOM, (uint32_t []) {(uint32_t) y_coordinate, (uint32_t) x_coordinate, exists}, 3);
+    t->exists[row] = exists ? t->exists[row] | bit : t->exists[row] & ~bit;
+    if (!exists && tile_is_empty(t))
+        release_tile(m, t);
     return;
 }
 
-/****************************************************************************************************************
- * initialize_display:        Purpose: Allocates room for, and initializes, a Display.                          *
- *                            Parameters: Room ***layout_array -> pointer to the 2D layout array to display *
- *                                        int32_t array_height -> the height of the 2D layout array             *
- *                                        int32_t array_width -> the width of the 2D layout array               *
- *                            Return value: Display * -> a pointer to the initialized Display                   *
- *                            Side effects: - allocates memory                                                  *
- *                                          - edits global variable "error_code"                                *
- ****************************************************************************************************************/
-Display *initialize_display(Room ***layout_array, int32_t array_height, int32_t array_width, Room *root)
+bool cursor_room_exists(Gamestate *g)
 {
-    Display *d = malloc(sizeof(Display));
-    if (d == NULL)
-    {
-        error_code = 6;
-        return NULL;
-    }
+    return room_exists(g->current_map, g->current_cursor_focus.y_coordinate, g->current_cursor_focus.x_coordinate);
+}
 
-    d->layout = layout_array;
-    d->height = array_height > MAX_DISPLAY_HEIGHT ? MAX_DISPLAY_HEIGHT : array_height;
-    d->width = array_width > MAX_DISPLAY_WIDTH ? MAX_DISPLAY_WIDTH : array_width;
-    d->y_offset = 0, d->x_offset = 0;
+void set_cursor_room_exists(Gamestate *g, bool exists)
+{
+    set_room_exists(g->current_map, g->current_cursor_focus.y_coordinate, g->current_cursor_focus.x_coordinate, exists);
+    return;
+}
 
-    return d;
+/*********************************************************************************************
+ * room_mark:    Purpose: Finds which mark (if any) the given room carries.                  *
+ *               Parameters: Gamestate *g -> the gamestate holding the marks                 *
+ *                           Coordinates room -> the room to check                           *
+ *               Return value: char -> 'S' for the start, 'E' for the end, or 0              *
+ *               Side effects: none                                                          *
+ *********************************************************************************************/
+char room_mark(Gamestate *g, Coordinates room)
+{
+    if (same_room(g->start, room))
+        return 'S';
+    if (same_room(g->end, room))
+        return 'E';
+    return 0;
 }
 
-Settings *initialize_settings(void)
+bool same_room(Coordinates a, Coordinates b)
 {
-    Settings *s = malloc(sizeof(Settings));
-    if (s == NULL)
+    return a.y_coordinate == b.y_coordinate && a.x_coordinate == b.x_coordinate;
+}
+
+/*********************************************************************************************
+ * edge_word:    Purpose: Finds the plane row holding the passage leading from the given     *
+ *                        room in the given direction (north/west passages belong to the     *
+ *                        neighbour, which stores them as its south/east passages).          *
+ *               Parameters: Map *m -> the map containing the room                           *
+ *                           int32_t y_coordinate, x_coordinate -> the room                  *
+ *                           int direction -> the cardinal direction of the passage          *
+ *                           bool allocate -> whether to allocate the tile if it is missing  *
+ *                           uint64_t *bit -> receives the mask of the passage's bit         *
+ *               Return value: uint64_t * -> the plane row (NULL if the tile isn't allocated)*
+ *               Side effects: - (if allocating) May allocate memory.                        *
+ *                             - (if allocating) Edits global variable "error_code"          *
+ *********************************************************************************************/
+uint64_t *edge_word(Map *m, int32_t y_coordinate, int32_t x_coordinate, int direction, bool allocate, uint64_t *bit)
+{
+    if (direction == NORTH)
+        y_coordinate--, direction = SOUTH;
+    else if (direction == WEST)
+        x_coordinate--, direction = EAST;
+
+    int row;
+    Tile *t = room_tile(m, y_coordinate, x_coordinate, allocate, &row, bit);
+    if (t == NULL)
+        return NULL;
+    return direction == SOUTH ? &t->south_edges[row] : &t->east_edges[row];
+}
+
+bool edge_in_map(Map *m, int32_t y_coordinate, int32_t x_coordinate, int direction)
+{
+    switch (direction)
+    {
+        case NORTH: return y_coordinate != 0;
+        case EAST: return x_coordinate != m->width - 1;
+        case SOUTH: return y_coordinate != m->height - 1;
+        case WEST: return x_coordinate != 0;
+        default: return false;
+    }
+}
+
+/*********************************************************************************************
+ * room_exit, set_room_exit:                                                                 *
+ *               Purpose: Read/write the passage leading from the given room in the given    *
+ *                        direction. There is never a passage off the edge of the map,       *
+ *                        so such a passage reads as closed and cannot be opened.            *
+ *               Parameters: Map *m -> the map containing the room                           *
+ *                           int32_t y_coordinate, x_coordinate -> the room                  *
+ *                           int direction -> the cardinal direction of the passage          *
+ *                           bool open -> (set_room_exit only) the new state of the passage  *
+ *               Return value: (room_exit only) bool -> whether the passage is open          *
+ *               Side effects: - (set_room_exit only) Edits the map (may allocate a tile).   *
+ *                             - (set_room_exit only) Records any change in the journal.     *
+ *                             - (set_room_exit only) Edits global variable "error_code"     *
+ *********************************************************************************************/
+bool room_exit(Map *m, int32_t y_coordinate, int32_t x_coordinate, int direction)
+{
+    if (!edge_in_map(m, y_coordinate, x_coordinate, direction))
+        return false;
+    uint64_t bit;
+    uint64_t *word = edge_word(m, y_coordinate, x_coordinate, direction, false, &bit);
+    return word != NULL && (*word & bit);
+}
+
+void set_room_exit(Map *m, int32_t y_coordinate, int32_t x_coordinate, int direction, bool open)
+{
+    if (!edge_in_map(m, y_coordinate, x_coordinate, direction))
+        return;
+    uint64_t bit;
+    uint64_t *word = edge_word(m, y_coordinate, x_coordinate, direction, open, &bit);
+    if (word == NULL)
+        return;
+    if (m->journal != NULL && ((*word & bit) != 0) != open)
+        journal_record(m->journal, JOURNAL_EXIT, (uint32_t []) {(uint32_t) y_coordinate, (uint32_t) x_coordinate, (uint32_t) direction, open}, 4);
+    *word = open ? *word | bit : *word & ~bit;
+    if (!open && m->last_tile != NULL && tile_is_empty(m->last_tile)) // edge_word() leaves the passage's tile in last_tile.
+        release_tile(m, m->last_tile);
+    return;
+}
+
+bool cursor_exit(Gamestate *g, int direction)
+{
+    return room_exit(g->current_map, g->current_cursor_focus.y_coordinate, g->current_cursor_focus.x_coordinate, direction);
+}
+
+void set_cursor_exit(Gamestate *g, int direction, bool open)
+{
+    set_room_exit(g->current_map, g->current_cursor_focus.y_coordinate, g->current_cursor_focus.x_coordinate, direction, open);
+    return;
+}
+
+/************************************************************************************************************
+ * edit_tile:    Purpose: Applies edit_region's operation to the part of the rectangle within one tile.     *
+ *               Parameters: Tile *t -> the tile to edit                                                    *
+ *                           int64_t world_top, world_left -> world coordinates of the rectangle's corner    *
+ *                           int64_t world_bottom, world_right -> one past its last row/column              *
+ *                           int planes, bool fill -> as for edit_region                                    *
+ *               Return value: none                                                                         *
+ *               Side effects: - Edits the tile.                                                            *
+ ************************************************************************************************************/
+void edit_tile(Tile *t, int64_t world_top, int64_t world_left, int64_t world_bottom, int64_t world_right, int planes, bool fill)
+{
+    int64_t tile_top = t->tile_y * TILE_SIZE, tile_left = t->tile_x * TILE_SIZE;
+    int64_t first_row = world_top > tile_top ? world_top - tile_top : 0;
+    int64_t end_row = world_bottom < tile_top + TILE_SIZE ? world_bottom - tile_top : TILE_SIZE;
+    int64_t first_column = world_left > tile_left ? world_left - tile_left : 0;
+    int64_t end_column = world_right < tile_left + TILE_SIZE ? world_right - tile_left : TILE_SIZE;
+    if (first_row >= end_row || first_column >= end_column)
+        return;
+
+    // One mask covers the rectangle's columns within every row of the tile:
+    int columns = (int) (end_column - first_column);
+    uint64_t mask = (columns == TILE_SIZE ? ~(uint64_t) 0 : ((uint64_t) 1 << columns) - 1) << first_column;
+    for (int64_t row = first_row; row < end_row; row++)
+    {
+        if (planes & TILE_PLANE_EXISTS)
+            t->exists[row] &= ~mask;
+        if (planes & TILE_PLANE_SOUTH)
+            t->south_edges[row] &= ~mask;
+        if (planes & TILE_PLANE_EAST)
+            t->east_edges[row] &= ~mask;
+        if (fill)
+            t->exists[row] |= mask;
+    }
+    return;
+}
+
+/************************************************************************************************************
+ * edit_region:    Purpose: Clears the given planes within a rectangle of rooms, then (if filling) makes    *
+ *                          every room in it exist. Clearing only visits tiles that are allocated, so even  *
+ *                          huge blank rectangles cost time proportional to the rooms actually drawn.       *
+ *                 Parameters: Map *m -> the map to edit                                                    *
+ *                             int32_t top, left -> map coordinates of the rectangle's top left room        *
+ *                             int32_t rows, columns -> the size of the rectangle                           *
+ *                             int planes -> which of TILE_PLANE_EXISTS/SOUTH/EAST to clear                 *
+ *                             bool fill -> whether the rooms should exist afterwards                       *
+ *                 Return value: none                                                                       *
+ *                 Side effects: - Edits the map (filling may allocate tiles).                              *
+ *                               - Edits global variable "error_code"                                       *
+ ************************************************************************************************************/
+void edit_region(Map *m, int32_t top, int32_t left, int32_t rows, int32_t columns, int planes, bool fill)
+{
+    if (rows <= 0 || columns <= 0)
+        return;
+
+    int64_t world_top = m->y_origin + top, world_left = m->x_origin + left;
+    int64_t world_bottom = world_top + rows, world_right = world_left + columns;
+    int unused_offset;
+    int64_t first_tile_y = tile_coordinate(world_top, &unused_offset), last_tile_y = tile_coordinate(world_bottom - 1, &unused_offset);
+    int64_t first_tile_x = tile_coordinate(world_left, &unused_offset), last_tile_x = tile_coordinate(world_right - 1, &unused_offset);
+
+    // Visit whichever is smaller: the tile coordinates covered by the rectangle, or the allocated tiles
+    // (filling has to visit every covered tile regardless, since it allocates them):
+    if (fill || (last_tile_y - first_tile_y + 1) * (last_tile_x - first_tile_x + 1) <= (int64_t) m->tile_slots)
+    {
+        for (int64_t tile_y = first_tile_y; tile_y <= last_tile_y; tile_y++)
+        {
+            for (int64_t tile_x = first_tile_x; tile_x <= last_tile_x; tile_x++)
+            {
+                Tile *t = fill ? touch_tile(m, tile_y, tile_x) : find_tile(m, tile_y, tile_x);
+                if (error_code)
+                    return;
+                if (t != NULL)
+                    edit_tile(t, world_top, world_left, world_bottom, world_right, planes, fill);
+                if (t != NULL && !fill && tile_is_empty(t))
+                    release_tile(m, t);
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < m->tile_slots; i++)
+        {
+            if (m->tiles[i] == NULL)
+                continue;
+            edit_tile(m->tiles[i], world_top, world_left, world_bottom, world_right, planes, fill);
+            if (tile_is_empty(m->tiles[i]))
+                release_tile(m, m->tiles[i]), i--; // Re-check this slot, which may now hold a tile shifted back from later in the run.
+        }
+    }
+    return;
+}
+
+/************************************************************************************************************
+ * grow_map:    Purpose: Adds the given number of rows/columns to each side of the map by moving its       *
+ *                       edges outward across the world's tiles, initializing only the newly added rooms.   *
+ *              Parameters: Map *m -> the map to grow                                                       *
+ *                          int32_t rows_north/columns_east/rows_south/columns_west -> the amount per side  *
+ *                          bool blank -> whether the new rooms start out deleted (allocating no tiles)     *
+ *              Return value: none                                                                          *
+ *              Side effects: - Edits the map (may allocate tiles).                                         *
+ *                            - Records the growth in the map's journal (if any).                           *
+ *                            - Edits global variable "error_code"                                          *
+ ************************************************************************************************************/
+void grow_map(Map *m, int32_t rows_north, int32_t columns_east, int32_t rows_south, int32_t columns_west, bool blank)
+{
+    if (m->journal != NULL)
+        journal_record(m->journal, JOURNAL_GROW, (uint32_t []) {(uint32_t) rows_north, (uint32_t) columns_east, (uint32_t) rows_south, (uint32_t) columns_west, blank}, 5);
+    int32_t old_height = m->height, old_width = m->width;
+    m->y_origin -= rows_north, m->x_origin -= columns_west;
+    m->height += rows_north + rows_south, m->width += columns_east + columns_west;
+
+    // New rows (full width), then new columns alongside the old rows
+    // (clearing anything left behind in those tiles by an earlier shrink):
+    edit_region(m, 0, 0, rows_north, m->width, TILE_PLANE_ALL, !blank);
+    edit_region(m, rows_north + old_height, 0, rows_south, m->width, TILE_PLANE_ALL, !blank);
+    edit_region(m, rows_north, 0, old_height, columns_west, TILE_PLANE_ALL, !blank);
+    edit_region(m, rows_north, columns_west + old_width, old_height, columns_east, TILE_PLANE_ALL, !blank);
+
+    // The old bottom row and rightmost column own the passages leading into the new rooms beyond them,
+    // which may still be open from before an earlier shrink:
+    if (rows_south)
+        edit_region(m, rows_north + old_height - 1, columns_west, 1, old_width, TILE_PLANE_SOUTH, false);
+    if (columns_east)
+        edit_region(m, rows_north, columns_west + old_width - 1, old_height, 1, TILE_PLANE_EAST, false);
+
+    return;
+}
+
+/************************************************************************************************************
+ * shrink_map:    Purpose: Removes the given number of rows/columns from each side of the map                *
+ *                         by moving its edges inward across the world's tiles.                              *
+ *                Parameters: Map *m -> the map to shrink                                                   *
+ *                            int32_t rows_north/columns_east/rows_south/columns_west -> the amount per side*
+ *                Return value: none                                                                        *
+ *                Side effects: - Edits the map's dimensions and origin.                                    *
+ *                              - Records the shrinking in the map's journal (if any).                      *
+ *                              - Edits global variable "error_code"                                        *
+ ************************************************************************************************************/
+void shrink_map(Map *m, int32_t rows_north, int32_t columns_east, int32_t rows_south, int32_t columns_west)
+{
+    if (m->journal != NULL)
+        journal_record(m->journal, JOURNAL_SHRINK, (uint32_t []) {(uint32_t) rows_north, (uint32_t) columns_east, (uint32_t) rows_south, (uint32_t) columns_west}, 4);
+    m->y_origin += rows_north, m->x_origin += columns_west;
+    m->height -= rows_north + rows_south, m->width -= columns_east + columns_west;
+
+    // The rooms left outside need no clearing: room_exit() never reports a passage off the map,
+    // and grow_map() clears them before they become part of the map again.
+    return;
+}
+
+/*********************************************************************************************
+ * shift_marks:  Purpose: Moves the start/end marks along with their rooms after the map's   *
+ *                        coordinate system has shifted.                                     *
+ *               Parameters: Gamestate *g -> the gamestate whose marks are to be shifted     *
+ *                           int32_t y_shift, x_shift -> the amount to shift by              *
+ *               Return value: none                                                          *
+ *               Side effects: - Edits the gamestate's start and end coordinates.            *
+ *********************************************************************************************/
+void shift_marks(Gamestate *g, int32_t y_shift, int32_t x_shift)
+{
+    if (!same_room(g->start, NO_ROOM))
+        g->start.y_coordinate += y_shift, g->start.x_coordinate += x_shift;
+    if (!same_room(g->end, NO_ROOM))
+        g->end.y_coordinate += y_shift, g->end.x_coordinate += x_shift;
+    return;
+}
+
+void unmark_outside_map(Gamestate *g)
+{
+    if (g->start.y_coordinate < 0 || g->start.y_coordinate >= g->current_map->height || g->start.x_coordinate < 0 || g->start.x_coordinate >= g->current_map->width)
+        g->start = NO_ROOM;
+    if (g->end.y_coordinate < 0 || g->end.y_coordinate >= g->current_map->height || g->end.x_coordinate < 0 || g->end.x_coordinate >= g->current_map->width)
+        g->end = NO_ROOM;
+    return;
+}
+
+/*****************************************************************************************
+ * load_gamestate:    Purpose: Loads a map from file for further editing, along with     *
+ *                             the display, settings and cursor it was saved with.       *
+ *                    Parameters: none                                                   *
+ *                    Return value: Gamestate * -> The loaded gamestate (which holds     *
+ *                                  the loaded map), to be passed into editing.          *
+ *                                  NULL if the user backs out or an error occurs.       *
+ *                    Side effects: - Clears screen and scrollback                       *
+ *                                  - Reads from external files (including the map's     *
+ *                                    journal, if an earlier session left one behind).   *
+ *                                  - Prints to stdout.                                  *
+ *                                  - Reads from stdin.                                  *
+ *                                  - Allocates memory.                                  *
+ *                                  - Edits global variable "error_code"                 *
+ *****************************************************************************************/
+Gamestate *load_gamestate(void)
+{
+    CLEAR_CONSOLE;
+    (void) printf("Loading map...\n");
+
+    // The gamestate is created first so that get_command() has somewhere to store the filename:
+    Gamestate *g = initialize_gamestate(NULL, NULL, NULL);
+    if (error_code)
+        return NULL;
+
+    for (;;)
+    {
+        if (get_command("Load which file? (Leave blank to return to the main menu.)\n> ", g, 's') == -1)
+            break;
+        if (g->current_filename[0] == '\0')
+            break;
+
+        // Accept the filename with or without its extension, but store it without (as save_gamestate() expects):
+        size_t name_length = strlen(g->current_filename), extension_length = strlen(SAVEFILE_EXTENSION);
+        if (name_length > extension_length && strcmp(g->current_filename + name_length - extension_length, SAVEFILE_EXTENSION) == 0)
+            g->current_filename[name_length - extension_length] = '\0';
+
+        const char *problem = read_savefile(g);
+        if (problem == NULL && recover_journal(g))
+        {
+            (void) printf("Recovered unsaved changes to %s%s from %s%s, left behind by an editing session that ended unexpectedly.\n", g->current_filename, SAVEFILE_EXTENSION, g->current_filename, JOURNAL_EXTENSION);
+            (void) printf("Press Enter to continue.\n"), gobble_line();
+        }
+        if (error_code)
+            break;
+        if (problem == NULL)
+            return g;
+        (void) printf("Unable to load %s%s: %s.\n", g->current_filename, SAVEFILE_EXTENSION, problem);
+        free(g->current_filename);
+        g->current_filename = NULL;
+    }
+
+    free_gamestate(g);
+    return NULL;
+}
+
+/*****************************************************************************************
+ * read_savefile:    Purpose: Maps the savefile named by the gamestate into memory       *
+ *                            (or, without POSIX, reads it in whole) and decodes it      *
+ *                            into the gamestate.                                        *
+ *                   Parameters: Gamestate *g -> the gamestate to load into              *
+ *                   Return value: const char * -> NULL on success, else the reason     *
+ *                                 the file couldn't be loaded                           *
+ *                   Side effects: - Reads from external files.                          *
+ *                                 - Allocates memory.                                   *
+ *                                 - Edits global variable "error_code"                  *
+ *****************************************************************************************/
+const char *read_savefile(Gamestate *g)
+{
+    char *path = savefile_path(g->current_filename, SAVEFILE_EXTENSION, false);
+    if (path == NULL)
+        return "out of memory";
+
+    const char *problem = NULL;
+    #ifdef POSIX_FILE_IO
+        int fd = open(path, O_RDONLY);
+        free(path);
+        if (fd == -1)
+            return "the file could not be opened";
+
+        struct stat file_status;
+        if (fstat(fd, &file_status) == -1 || !S_ISREG(file_status.st_mode))
+            problem = "not a regular file";
+        else if ((uintmax_t) file_status.st_size > SIZE_MAX)
+            problem = "the file is too large to load";
+        else if (file_status.st_size == 0) // (mmap() refuses empty mappings.)
+            problem = decode_savefile(g, NULL, 0);
+        else
+        {
+            size_t length = (size_t) file_status.st_size;
+            void *image = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (image == MAP_FAILED)
+                problem = "the file could not be mapped into memory";
+            else
+            {
+                (void) posix_madvise(image, length, POSIX_MADV_SEQUENTIAL);
+                problem = decode_savefile(g, image, length);
+                (void) munmap(image, length);
+            }
+        }
+        (void) close(fd);
+    #else
+        FILE *loadfile = fopen(path, "rb");
+        free(path);
+        if (loadfile == NULL)
+            return "the file could not be opened";
+
+        unsigned char *image = NULL;
+        size_t length = 0;
+        problem = read_whole_file(loadfile, &image, &length);
+        if (problem == NULL)
+            problem = decode_savefile(g, image, length);
+        free(image);
+        (void) fclose(loadfile);
+    #endif
+    return problem;
+}
+
+/*****************************************************************************************
+ * read_whole_file:    Purpose: Reads a file (from its start) into memory in one go.     *
+ *                     Parameters: FILE *file -> the file, opened for binary reading     *
+ *                                 unsigned char **image -> receives the contents, to be *
+ *                                                          freed by the caller          *
+ *                                 size_t *length -> receives the length of the contents *
+ *                     Return value: const char * -> NULL on success, else the problem   *
+ *                     Side effects: - Reads from the file.                              *
+ *                                   - Allocates memory.                                 *
+ *                                   - Edits global variable "error_code"                *
+ *****************************************************************************************/
+const char *read_whole_file(FILE *file, unsigned char **image, size_t *length)
+{
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+        size = ftell(file);
+    if (size < 0 || fseek(file, 0, SEEK_SET) != 0)
+        return "the file's size could not be determined";
+    if ((*image = malloc(size > 0 ? (size_t) size : 1)) == NULL)
+    {
+        error_code = 31;
+        return "out of memory";
+    }
+    if (fread(*image, 1, (size_t) size, file) != (size_t) size)
+        return "the file could not be read";
+    *length = (size_t) size;
+    return NULL;
+}
+
+/*****************************************************************************************
+ * savefile_path:    Purpose: Gives the name of a file belonging to a map (the           *
+ *                            gamestate's filename plus the given extension), or of the  *
+ *                            temporary file it is first written to.                     *
+ *                   Parameters: char *filename -> the filename, without its extension   *
+ *                               const char *extension -> SAVEFILE_EXTENSION or          *
+ *                                                        JOURNAL_EXTENSION              *
+ *                               bool temporary -> whether to name the temporary file    *
+ *                   Return value: char * -> the path, to be freed by the caller         *
+ *                                 (NULL if it couldn't be allocated)                    *
+ *                   Side effects: - Allocates memory.                                   *
+ *                                 - Edits global variable "error_code"                  *
+ *****************************************************************************************/
+char *savefile_path(char *filename, const char *extension, bool temporary)
+{
+    char *path = malloc(strlen(filename) + strlen(extension) + strlen(SAVEFILE_TEMPORARY_EXTENSION) + 1);
+    if (path == NULL)
+    {
+        error_code = 30;
+        return NULL;
+    }
+    (void) strcpy(path, filename);
+    (void) strcat(path, extension);
+    if (temporary)
+        (void) strcat(path, SAVEFILE_TEMPORARY_EXTENSION);
+    return path;
+}
+
+/*********************************************************************************************
+ * decode_savefile:    Purpose: Validates a savefile's contents and builds the map, display  *
+ *                              and settings they describe into the gamestate. Files         *
+ *                              starting with SAVEFILE_MAGIC are in the sectioned format;    *
+ *                              anything else is taken to be an original (v1) savefile.      *
+ *                     Parameters: Gamestate *g -> the gamestate to load into                *
+ *                                 const unsigned char *image -> the savefile's contents     *
+ *                                 size_t length -> the savefile's length in bytes           *
+ *                     Return value: const char * -> NULL on success, else what is wrong     *
+ *                                   with the file                                           *
+ *                     Side effects: - Allocates memory (freed again on failure).            *
+ *                                   - Edits the gamestate, including where its journal      *
+ *                                     starts from (only on success).                        *
+ *                                   - Edits global variable "error_code"                    *
+ *********************************************************************************************/
+const char *decode_savefile(Gamestate *g, const unsigned char *image, size_t length)
+{
+    // (No v1 file can start with the magic: read as a v1 map height, it exceeds MAX_COORDINATE.)
+    if (length >= SAVEFILE_PREAMBLE_SIZE && memcmp(image, SAVEFILE_MAGIC, strlen(SAVEFILE_MAGIC)) == 0)
+    {
+        const char *problem = decode_savefile_v2(g, image, length);
+        if (problem == NULL) // A journal can follow on from this file (its header identifies its contents):
+            rebase_journal(g, true, crc32_update(0, image, SAVEFILE_PREAMBLE_SIZE + (size_t) read_le16(image + 6) * SAVEFILE_SECTION_ENTRY_SIZE), length);
+        return problem;
+    }
+    const char *problem = decode_savefile_v1(g, image, length);
+    if (problem == NULL) // (A journal for a v1 file starts from a snapshot of its own.)
+        rebase_journal(g, false, 0, length);
+    return problem;
+}
+
+/*********************************************************************************************
+ * decode_savefile_v1:    Purpose: Decodes an original savefile: a header, then one record   *
+ *                                 per room (read in a single pass, a tile row at a time),   *
+ *                                 then a trailer holding the display, settings and cursor.  *
+ *                        Parameters, return value and side effects: as for decode_savefile  *
+ *********************************************************************************************/
+const char *decode_savefile_v1(Gamestate *g, const unsigned char *image, size_t length)
+{
+    // Header: map height, width and room count:
+    if (length < SAVEFILE_V1_HEADER_SIZE)
+        return "the file is too short to hold a map";
+    int32_t height = read_int32(image), width = read_int32(image + 4), room_count = read_int32(image + 8);
+    if (height < 1 || height > MAX_COORDINATE || width < 1 || width > MAX_COORDINATE)
+        return "the map's dimensions are out of range";
+    uint64_t rooms = (uint64_t) height * (uint64_t) width;
+    if (rooms <= INT32_MAX && room_count != (int32_t) rooms) // (Larger counts overflowed their int32_t when saved.)
+        return "the room count doesn't match the map's dimensions";
+    if ((uint64_t) length != SAVEFILE_V1_HEADER_SIZE + rooms * SAVEFILE_V1_ROOM_SIZE + SAVEFILE_V1_TRAILER_SIZE) // Can't overflow, due to MAX_COORDINATE.
+        return "the file's length doesn't match the map's dimensions";
+
+    // Trailer (checked before anything is built): display, movement mode, maximum display size and cursor:
+    const unsigned char *trailer = image + length - SAVEFILE_V1_TRAILER_SIZE;
+    if (trailer[16] > 1)
+        return "the saved movement mode is unknown";
+    Display display = {read_int32(trailer), read_int32(trailer + 4), read_int32(trailer + 8), read_int32(trailer + 12)};
+    Settings settings = {trailer[16] == 0 ? NESW : WASD, read_int32(trailer + 17), read_int32(trailer + 21)};
+    Coordinates cursor = {read_int32(trailer + 25), read_int32(trailer + 29)};
+    const char *problem = check_saved_view(height, width, &display, &settings, cursor);
+    if (problem != NULL)
+        return problem;
+
+    // Start from a blank map of the right size (no tiles allocated):
+    Map *m = create_map((Dimensions) {0, 0});
+    if (error_code)
+        return free_map(m), "out of memory";
+    grow_map(m, 0, width, height, 0, true);
+
+    // Rooms, in row-major order, gathered into plane rows a tile's width at a time. Each passage is stored by both
+    // of its rooms, so a north/west exit is merged into the neighbour's south/east passage; exits off the map are dropped:
+    const unsigned char *record = image + SAVEFILE_V1_HEADER_SIZE;
+    Coordinates start = NO_ROOM, end = NO_ROOM;
+    for (int32_t y = 0; y < height && problem == NULL; y++)
+    {
+        int64_t tile_y = y / TILE_SIZE;
+        int row = y % TILE_SIZE;
+        for (int32_t left = 0; left < width && problem == NULL; left += TILE_SIZE)
+        {
+            int64_t tile_x = left / TILE_SIZE;
+            int columns = width - left < TILE_SIZE ? (int) (width - left) : TILE_SIZE;
+            uint64_t exists = 0, north = 0, east = 0, south = 0, west = 0;
+            for (int column = 0; column < columns; column++, record += SAVEFILE_V1_ROOM_SIZE)
+            {
+                if (read_int32(record) != y || read_int32(record + 4) != left + column)
+                {
+                    problem = "the rooms are out of order";
+                    break;
+                }
+                if ((record[8] | record[9] | record[10] | record[11] | record[12]) > 1 || record[13] > 2)
+                {
+                    problem = "a room holds an invalid value";
+                    break;
+                }
+
+                uint64_t bit = (uint64_t) 1 << column;
+                exists |= record[8] ? bit : 0;
+                north |= record[9] ? bit : 0;
+                east |= record[10] ? bit : 0;
+                south |= record[11] ? bit : 0;
+                west |= record[12] ? bit : 0;
+
+                if (record[13] != 0)
+                {
+                    Coordinates *mark = record[13] == 1 ? &start : &end;
+                    if (!same_room(*mark, NO_ROOM))
+                    {
+                        problem = "the map has more than one start or end";
+                        break;
+                    }
+                    mark->y_coordinate = y, mark->x_coordinate = left + column;
+                }
+            }
+            if (problem != NULL)
+                break;
+
+            if (y == 0)
+                north = 0;
+            if (y == height - 1)
+                south = 0;
+            if (left == 0)
+                west &= ~(uint64_t) 1;
+            if (left + columns == width)
+                east &= ~((uint64_t) 1 << (columns - 1));
+
+            if (!merge_tile_row(m, tile_y, tile_x, row, TILE_PLANE_EXISTS, exists)
+                || !merge_tile_row(m, tile_y, tile_x, row, TILE_PLANE_SOUTH, south)
+                || !merge_tile_row(m, tile_y, tile_x, row, TILE_PLANE_EAST, east | west >> 1)
+                || (y > 0 && !merge_tile_row(m, (y - 1) / TILE_SIZE, tile_x, (y - 1) % TILE_SIZE, TILE_PLANE_SOUTH, north))
+                || (left > 0 && !merge_tile_row(m, tile_y, tile_x - 1, row, TILE_PLANE_EAST, (west & 1) << (TILE_SIZE - 1))))
+                problem = "out of memory";
+        }
+    }
+    if (problem != NULL)
+        return free_map(m), problem;
+
+    return install_loaded_state(g, m, &display, &settings, cursor, start, end);
+}
+
+/*********************************************************************************************
+ * decode_savefile_v2:    Purpose: Decodes a sectioned savefile: a preamble (magic, version, *
+ *                                 section count) and a table giving each section's type,    *
+ *                                 CRC-32, offset and length. Every section but the map (raw *
+ *                                 or packed) is optional, and sections of unknown types are *
+ *                                 skipped.                                                  *
+ *                                 All integers are little-endian.                           *
+ *                        Parameters, return value and side effects: as for decode_savefile  *
+ *********************************************************************************************/
+const char *decode_savefile_v2(Gamestate *g, const unsigned char *image, size_t length)
+{
+    if (read_le16(image + 4) != SAVEFILE_VERSION)
+        return "the file's format version is not supported";
+    uint16_t section_count = read_le16(image + 6);
+    if (length < SAVEFILE_PREAMBLE_SIZE + (size_t) section_count * SAVEFILE_SECTION_ENTRY_SIZE)
+        return "the file's section table is truncated";
+
+    // Locate the sections, checking each known one against its CRC:
+    const unsigned char *section[NUM_SAVEFILE_SECTIONS] = {NULL};
+    uint64_t section_length[NUM_SAVEFILE_SECTIONS] = {0};
+    for (uint16_t i = 0; i < section_count; i++)
+    {
+        const unsigned char *entry = image + SAVEFILE_PREAMBLE_SIZE + (size_t) i * SAVEFILE_SECTION_ENTRY_SIZE;
+        uint32_t type = read_le32(entry), crc = read_le32(entry + 4);
+        uint64_t offset = read_le64(entry + 8), size = read_le64(entry + 16);
+        if (offset > length || size > length - offset)
+            return "a section lies outside the file";
+        if (type >= NUM_SAVEFILE_SECTIONS)
+            continue;
+        if (section[type] != NULL)
+            return "a section appears twice";
+        if (crc32_update(0, image + offset, (size_t) size) != crc)
+            return "a section failed its checksum (the file is corrupt)";
+        section[type] = image + offset, section_length[type] = size;
+    }
+
+    // Map section: height and width (int32_t each), then the exists, south and east planes, each holding one bit
+    // per room in row-major order. Either they are padded to a whole byte each, or (in the packed map section)
+    // they are coded together as runs (see encode_packed_map_section()):
+    if (section[MAP_SECTION] != NULL && section[PACKED_MAP_SECTION] != NULL)
+        return "the file holds two maps";
+    int map_section = section[MAP_SECTION] != NULL ? MAP_SECTION : PACKED_MAP_SECTION;
+    if (section[map_section] == NULL)
+        return "the file holds no map";
+    if (section_length[map_section] < 8)
+        return "a section has the wrong length";
+    int32_t height = (int32_t) read_le32(section[map_section]), width = (int32_t) read_le32(section[map_section] + 4);
+    if (height < 1 || height > MAX_COORDINATE || width < 1 || width > MAX_COORDINATE)
+        return "the map's dimensions are out of range";
+    uint64_t rooms = (uint64_t) height * (uint64_t) width, plane_bytes = (rooms + 7) / 8;
+    if (map_section == MAP_SECTION && section_length[MAP_SECTION] != 8 + 3 * plane_bytes)
+        return "the map section's length doesn't match the map's dimensions";
+
+    // The other sections default as for a new map (print_display() fits the display to the map):
+    Display display = {1, 1, 0, 0};
+    Settings settings = {NESW, MAX_DISPLAY_HEIGHT, MAX_DISPLAY_WIDTH};
+    Coordinates cursor = {0, 0}, start = NO_ROOM, end = NO_ROOM;
+    const unsigned char *s;
+    if ((s = section[MARKS_SECTION]) != NULL) // start y, start x, end y, end x = int32_t (NO_COORDINATE if unmarked)
+    {
+        if (section_length[MARKS_SECTION] != 16)
+            return "a section has the wrong length";
+        start.y_coordinate = (int32_t) read_le32(s), start.x_coordinate = (int32_t) read_le32(s + 4);
+        end.y_coordinate = (int32_t) read_le32(s + 8), end.x_coordinate = (int32_t) read_le32(s + 12);
+    }
+    if ((s = section[DISPLAY_SECTION]) != NULL) // height, width, y_offset, x_offset = int32_t
+    {
+        if (section_length[DISPLAY_SECTION] != 16)
+            return "a section has the wrong length";
+        display.height = (int32_t) read_le32(s), display.width = (int32_t) read_le32(s + 4);
+        display.y_offset = (int32_t) read_le32(s + 8), display.x_offset = (int32_t) read_le32(s + 12);
+    }
+    if ((s = section[SETTINGS_SECTION]) != NULL) // movement mode = uint8_t, max display height, width = int32_t
+    {
+        if (section_length[SETTINGS_SECTION] != 9)
+            return "a section has the wrong length";
+        if (s[0] > 1)
+            return "the saved movement mode is unknown";
+        settings.movement_mode = s[0] == 0 ? NESW : WASD;
+        settings.max_display_height = (int32_t) read_le32(s + 1), settings.max_display_width = (int32_t) read_le32(s + 5);
+    }
+    if ((s = section[CURSOR_SECTION]) != NULL) // y, x = int32_t
+    {
+        if (section_length[CURSOR_SECTION] != 8)
+            return "a section has the wrong length";
+        cursor.y_coordinate = (int32_t) read_le32(s), cursor.x_coordinate = (int32_t) read_le32(s + 4);
+    }
+
+    const char *problem = check_saved_view(height, width, &display, &settings, cursor);
+    if (problem != NULL)
+        return problem;
+    Coordinates marks[2] = {start, end};
+    for (int i = 0; i < 2; i++)
+    {
+        if (!same_room(marks[i], NO_ROOM) && (marks[i].y_coordinate < 0 || marks[i].y_coordinate >= height || marks[i].x_coordinate < 0 || marks[i].x_coordinate >= width))
+            return "a saved mark is off the map";
+    }
+
+    // Start from a blank map of the right size (no tiles allocated), then merge in the planes a tile row at a time
+    // (passages off the map are dropped):
+    Map *m = create_map((Dimensions) {0, 0});
+    if (error_code)
+        return free_map(m), "out of memory";
+    grow_map(m, 0, width, height, 0, true);
+
+    const int planes[3] = {TILE_PLANE_EXISTS, TILE_PLANE_SOUTH, TILE_PLANE_EAST};
+    if (map_section == PACKED_MAP_SECTION)
+    {
+        Run_Models models;
+        initialize_run_models(&models);
+        Range_Decoder d;
+        start_range_decoder(&d, section[PACKED_MAP_SECTION] + 8, (size_t) section_length[PACKED_MAP_SECTION] - 8);
+        for (int p = 0; p < 3; p++)
+        {
+            int value = decode_bit(&d, &models.first_bit[p]);
+            for (uint64_t position = 0; position < rooms; value = !value)
+            {
+                uint64_t run = decode_run(&d, &models, p, value);
+                if (d.overrun || run > rooms - position)
+                    return free_map(m), "the compressed map is corrupt";
+                if (value && !set_plane_bits(m, planes[p], position, run))
+                    return free_map(m), "out of memory";
+                position += run;
+            }
+        }
+        edit_region(m, height - 1, 0, 1, width, TILE_PLANE_SOUTH, false);
+        edit_region(m, 0, width - 1, height, 1, TILE_PLANE_EAST, false);
+        return install_loaded_state(g, m, &display, &settings, cursor, start, end);
+    }
+    for (int p = 0; p < 3; p++)
+    {
+        const unsigned char *plane = section[MAP_SECTION] + 8 + p * plane_bytes;
+        for (int32_t y = 0; y < height; y++)
+        {
+            for (int32_t left = 0; left < width; left += TILE_SIZE)
+            {
+                int columns = width - left < TILE_SIZE ? (int) (width - left) : TILE_SIZE;
+                uint64_t bits = read_bits(plane, (uint64_t) y * (uint64_t) width + (uint64_t) left, columns);
+                if (planes[p] == TILE_PLANE_SOUTH && y == height - 1)
+                    bits = 0;
+                if (planes[p] == TILE_PLANE_EAST && left + columns == width)
+                    bits &= ~((uint64_t) 1 << (columns - 1));
+                if (!merge_tile_row(m, y / TILE_SIZE, left / TILE_SIZE, y % TILE_SIZE, planes[p], bits))
+                    return free_map(m), "out of memory";
+            }
+        }
+    }
+
+    return install_loaded_state(g, m, &display, &settings, cursor, start, end);
+}
+
+/*********************************************************************************************
+ * check_saved_view:    Purpose: Checks a loaded display, settings and cursor against the    *
+ *                               loaded map's size. print_display() fits the display to the  *
+ *                               map, so only values it can't repair are rejected.           *
+ *                      Parameters: int32_t height, width -> the size of the loaded map      *
+ *                                  Display *d, Settings *s, Coordinates cursor -> as loaded *
+ *                      Return value: const char * -> NULL if acceptable, else the problem   *
+ *                      Side effects: none                                                   *
+ *********************************************************************************************/
+const char *check_saved_view(int32_t height, int32_t width, Display *d, Settings *s, Coordinates cursor)
+{
+    if (d->height < 1 || d->width < 1 || d->y_offset < 0 || d->y_offset >= height || d->x_offset < 0 || d->x_offset >= width)
+        return "the saved display is off the map";
+    if (s->max_display_height < 1 || s->max_display_height > MAX_COORDINATE || s->max_display_width < 1 || s->max_display_width > MAX_COORDINATE)
+        return "the saved maximum display size is out of range";
+    if (cursor.y_coordinate < 0 || cursor.y_coordinate >= height || cursor.x_coordinate < 0 || cursor.x_coordinate >= width)
+        return "the saved cursor is off the map";
+    return NULL;
+}
+
+/*********************************************************************************************
+ * install_loaded_state:    Purpose: Hands a loaded map, along with copies of the loaded     *
+ *                                   display and settings, to the gamestate.                 *
+ *                          Parameters: Gamestate *g -> the gamestate to load into           *
+ *                                      Map *m -> the loaded map (freed on failure)          *
+ *                                      Display *d, Settings *s -> the values to copy        *
+ *                                      Coordinates cursor, start, end -> as loaded          *
+ *                          Return value: const char * -> NULL on success, else the problem  *
+ *                          Side effects: - Allocates memory.                                *
+ *                                        - Edits the gamestate (only on success).           *
+ *                                        - Edits global variable "error_code"               *
+ *********************************************************************************************/
+const char *install_loaded_state(Gamestate *g, Map *m, Display *d, Settings *s, Coordinates cursor, Coordinates start, Coordinates end)
+{
+    Display *display = initialize_display(m->height, m->width);
+    if (error_code)
+        return free_map(m), "out of memory";
+    Settings *settings = initialize_settings();
+    if (error_code)
+        return free(display), free_map(m), "out of memory";
+    *display = *d, *settings = *s;
+
+    g->current_map = m;
+    g->display = display;
+    g->user_settings = settings;
+    g->current_cursor_focus = cursor;
+    g->start = start, g->end = end;
+    g->saved = true; // Nothing has changed since the file was saved.
+    return NULL;
+}
+
+/*********************************************************************************************
+ * read_int32:    Purpose: Reads an int32_t (in the machine's byte order, as v1 savefiles    *
+ *                         are written) from a possibly unaligned position in a savefile.    *
+ *                Parameters: const unsigned char *bytes -> the position to read from        *
+ *                Return value: int32_t -> the value read                                    *
+ *                Side effects: none                                                         *
+ *********************************************************************************************/
+int32_t read_int32(const unsigned char *bytes)
+{
+    int32_t value;
+    (void) memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+/*********************************************************************************************
+ * read_le16, read_le32, read_le64, write_le16, write_le32, write_le64:                      *
+ *                Purpose: Read/write little-endian integers (as v2 savefiles use) at        *
+ *                         possibly unaligned positions, whatever the machine's byte order.  *
+ *                Parameters: (const) unsigned char *bytes -> the position to read/write     *
+ *                            value -> (write functions only) the value to write             *
+ *                Return value: (read functions only) the value read                         *
+ *                Side effects: - (write functions only) Edits the bytes.                    *
+ *********************************************************************************************/
+uint16_t read_le16(const unsigned char *bytes)
+{
+    return (uint16_t) (bytes[0] | bytes[1] << 8);
+}
+
+uint32_t read_le32(const unsigned char *bytes)
+{
+    return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+
+uint64_t read_le64(const unsigned char *bytes)
+{
+    return (uint64_t) read_le32(bytes) | (uint64_t) read_le32(bytes + 4) << 32;
+}
+
+void write_le16(unsigned char *bytes, uint16_t value)
+{
+    bytes[0] = (unsigned char) value, bytes[1] = (unsigned char) (value >> 8);
+    return;
+}
+
+void write_le32(unsigned char *bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        bytes[i] = (unsigned char) (value >> (8 * i));
+    return;
+}
+
+void write_le64(unsigned char *bytes, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        bytes[i] = (unsigned char) (value >> (8 * i));
+    return;
+}
+
+/*********************************************************************************************
+ * read_bits:    Purpose: Reads up to 64 consecutive bits from a bit-packed plane (bit 0 of  *
+ *                        byte 0 first), touching only the bytes that hold them.             *
+ *               Parameters: const unsigned char *bytes -> the plane                         *
+ *                           uint64_t first_bit -> the index of the first bit to read        *
+ *                           int count -> the number of bits to read (1 to 64)               *
+ *               Return value: uint64_t -> the bits, the first in bit 0                      *
+ *               Side effects: none                                                          *
+ *********************************************************************************************/
+uint64_t read_bits(const unsigned char *bytes, uint64_t first_bit, int count)
+{
+    const unsigned char *first_byte = bytes + first_bit / 8;
+    int shift = (int) (first_bit % 8), byte_count = (shift + count + 7) / 8; // (Up to 9 bytes.)
+    uint64_t value = 0;
+    for (int i = 0; i < byte_count && i < 8; i++)
+        value |= (uint64_t) first_byte[i] << (8 * i);
+    value >>= shift;
+    if (byte_count == 9)
+        value |= (uint64_t) first_byte[8] << (64 - shift);
+    return count == 64 ? value : value & (((uint64_t) 1 << count) - 1);
+}
+
+/*********************************************************************************************
+ * crc32_update:    Purpose: Extends a CRC-32 (the IEEE polynomial, as used by zip and PNG)  *
+ *                           over more bytes; start from 0. The lookup table is built on     *
+ *                           first use.                                                      *
+ *                  Parameters: uint32_t crc -> the CRC of the bytes so far                  *
+ *                              const unsigned char *bytes, size_t count -> the new bytes    *
+ *                  Return value: uint32_t -> the CRC of all the bytes                       *
+ *                  Side effects: none                                                       *
+ *********************************************************************************************/
+uint32_t crc32_update(uint32_t crc, const unsigned char *bytes, size_t count)
+{
+    static uint32_t table[256];
+    static bool table_built = false;
+    if (!table_built)
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        table_built = true;
+    }
+
+    crc = ~crc;
+    while (count-- > 0)
+        crc = table[(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+/*********************************************************************************************
+ * start_range_decoder, decode_bit, decode_direct_bit, next_coded_byte:                      *
+ *               Purpose: The decoding side of encode_bit() and friends. Reading past the    *
+ *                        end of the coded bytes (which only a corrupt file can cause) yields *
+ *                        zeros and sets d->overrun.                                         *
+ *               Parameters: Range_Decoder *d -> the decoder                                 *
+ *                           const unsigned char *bytes, size_t length -> (start_range_      *
+ *                                                                        decoder only) the  *
+ *                                                                        coded bytes        *
+ *                           uint16_t *probability -> (decode_bit only) the bit's model      *
+ *               Return value: (decode_bit/decode_direct_bit) int -> the bit decoded         *
+ *                             (next_coded_byte) unsigned char -> the next coded byte        *
+ *               Side effects: - Edits the decoder.                                          *
+ *                             - (decode_bit only) Edits the model.                          *
+ *********************************************************************************************/
+void start_range_decoder(Range_Decoder *d, const unsigned char *bytes, size_t length)
+{
+    d->next = bytes, d->end = bytes + length;
+    d->overrun = false;
+    d->range = 0xFFFFFFFFu, d->code = 0;
+    for (int i = 0; i < 5; i++)
+        d->code = d->code << 8 | next_coded_byte(d);
+    return;
+}
+
+int decode_bit(Range_Decoder *d, uint16_t *probability)
+{
+    int bit;
+    uint32_t bound = (d->range >> RANGE_MODEL_BITS) * *probability;
+    if (d->code < bound)
+    {
+        d->range = bound;
+        *probability += (RANGE_MODEL_ONE - *probability) >> RANGE_MOVE_BITS;
+        bit = 0;
+    }
+    else
+    {
+        d->code -= bound;
+        d->range -= bound;
+        *probability -= *probability >> RANGE_MOVE_BITS;
+        bit = 1;
+    }
+    while (d->range < RANGE_TOP)
+        d->range <<= 8, d->code = d->code << 8 | next_coded_byte(d);
+    return bit;
+}
+
+int decode_direct_bit(Range_Decoder *d)
+{
+    d->range >>= 1;
+    int bit = d->code >= d->range;
+    if (bit)
+        d->code -= d->range;
+    while (d->range < RANGE_TOP)
+        d->range <<= 8, d->code = d->code << 8 | next_coded_byte(d);
+    return bit;
+}
+
+unsigned char next_coded_byte(Range_Decoder *d)
+{
+    if (d->next == d->end)
+        return d->overrun = true, 0;
+    return *d->next++;
+}
+
+/*********************************************************************************************
+ * set_plane_bits:    Purpose: Sets a run of bits in one plane of the map, counting bits in  *
+ *                             row-major order from the map's top left room, a tile row at   *
+ *                             a time (the map's origin must be the world's).                *
+ *                    Parameters: Map *m -> the map to edit                                  *
+ *                                int plane -> one of TILE_PLANE_EXISTS/SOUTH/EAST           *
+ *                                uint64_t first_bit, count -> the run of bits               *
+ *                    Return value: bool -> false if a tile couldn't be allocated            *
+ *                    Side effects: - Edits the map (may allocate tiles).                    *
+ *                                  - Edits global variable "error_code"                     *
+ *********************************************************************************************/
+bool set_plane_bits(Map *m, int plane, uint64_t first_bit, uint64_t count)
+{
+    while (count > 0)
+    {
+        int32_t y = (int32_t) (first_bit / (uint64_t) m->width), x = (int32_t) (first_bit % (uint64_t) m->width);
+        int column = x % TILE_SIZE;
+        uint64_t bits_here = (uint64_t) (m->width - x) < (uint64_t) (TILE_SIZE - column) ? (uint64_t) (m->width - x) : (uint64_t) (TILE_SIZE - column);
+        if (bits_here > count)
+            bits_here = count;
+        uint64_t bits = (bits_here == TILE_SIZE ? ~(uint64_t) 0 : ((uint64_t) 1 << bits_here) - 1) << column;
+        if (!merge_tile_row(m, y / TILE_SIZE, x / TILE_SIZE, y % TILE_SIZE, plane, bits))
+            return false;
+        first_bit += bits_here, count -= bits_here;
+    }
+    return true;
+}
+
+/*********************************************************************************************
+ * count_trailing_zeros, count_leading_zeros:                                                *
+ *               Purpose: Count the zero bits below the lowest 1 / above the highest 1.      *
+ *               Parameters: uint64_t bits -> the bits to examine (must not be 0)            *
+ *               Return value: int -> the count                                              *
+ *               Side effects: none                                                          *
+ *********************************************************************************************/
+int count_trailing_zeros(uint64_t bits)
+{
+    #if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(bits);
+    #else
+        int count = 0;
+        for (; !(bits & 1); bits >>= 1)
+            count++;
+        return count;
+    #endif
+}
+
+int count_leading_zeros(uint64_t bits)
+{
+    #if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(bits);
+    #else
+        int count = 0;
+        for (; !(bits >> 63); bits <<= 1)
+            count++;
+        return count;
+    #endif
+}
+
+/*********************************************************************************************
+ * merge_tile_row:    Purpose: Sets the given bits in one row of one plane of a tile,        *
+ *                             allocating the tile only if there is anything to set.         *
+ *                    Parameters: Map *m -> the map containing the tile                      *
+ *                                int64_t tile_y, tile_x -> the tile coordinates             *
+ *                                int row -> the row within the tile                         *
+ *                                int plane -> one of TILE_PLANE_EXISTS/SOUTH/EAST           *
+ *                                uint64_t bits -> the bits to set                           *
+ *                    Return value: bool -> false if the tile couldn't be allocated          *
+ *                    Side effects: - Edits the map (may allocate a tile).                   *
+ *                                  - Edits global variable "error_code"                     *
+ *********************************************************************************************/
+bool merge_tile_row(Map *m, int64_t tile_y, int64_t tile_x, int row, int plane, uint64_t bits)
+{
+    if (bits == 0)
+        return true;
+    Tile *t = touch_tile(m, tile_y, tile_x);
+    if (t == NULL)
+        return false;
+    if (plane == TILE_PLANE_EXISTS)
+        t->exists[row] |= bits;
+    else if (plane == TILE_PLANE_SOUTH)
+        t->south_edges[row] |= bits;
+    else
+        t->east_edges[row] |= bits;
+    return true;
+}
+
+/*********************************************************************************************
+ * recover_journal:    Purpose: Replays the journal an earlier session left behind for the   *
+ *                              map just loaded (see journal_command): a journal starting    *
+ *                              from the savefile is replayed only if the savefile is still  *
+ *                              the one it started from, while one starting from a snapshot  *
+ *                              replaces the loaded map outright. Replay stops at the first  *
+ *                              frame that is torn or fails its CRC.                         *
+ *                     Parameters: Gamestate *g -> the gamestate just loaded                 *
+ *                     Return value: bool -> whether anything was recovered                  *
+ *                     Side effects: - Reads from the journal file.                          *
+ *                                   - Edits the gamestate (if anything is recovered).       *
+ *                                   - Allocates/frees memory.                               *
+ *                                   - Edits global variable "error_code"                    *
+ *********************************************************************************************/
+bool recover_journal(Gamestate *g)
+{
+    char *path = savefile_path(g->current_filename, JOURNAL_EXTENSION, false);
+    if (path == NULL)
+        return false;
+    FILE *journal_file = fopen(path, "rb");
+    if (journal_file == NULL)
+        return free(path), false;
+    unsigned char *image = NULL;
+    size_t length = 0;
+    const char *problem = read_whole_file(journal_file, &image, &length);
+    (void) fclose(journal_file);
+
+    size_t position = 0;
+    bool recovered = false;
+    if (problem != NULL)
+        position = length = 0;
+    else if (length >= JOURNAL_HEADER_SIZE && memcmp(image, JOURNAL_MAGIC, strlen(JOURNAL_MAGIC)) == 0)
+    {
+        // (A journal that started from some other version of the savefile is stale.)
+        if (read_le16(image + 4) == JOURNAL_VERSION && g->journal.based_on_savefile && read_le32(image + 8) == g->journal.savefile_crc)
+            position = JOURNAL_HEADER_SIZE;
+        else
+            position = length;
+    }
+    else if (length >= SAVEFILE_PREAMBLE_SIZE && memcmp(image, SAVEFILE_MAGIC, strlen(SAVEFILE_MAGIC)) == 0)
+    {
+        // Swap in the snapshot's map, display, settings, cursor and marks for the loaded ones:
+        position = savefile_v2_length(image, length);
+        Gamestate *snapshot = initialize_gamestate(NULL, NULL, NULL);
+        if (error_code || decode_savefile(snapshot, image, position) != NULL)
+            position = length;
+        else
+        {
+            free_map(g->current_map), free(g->display), free(g->user_settings);
+            g->current_map = snapshot->current_map, g->display = snapshot->display, g->user_settings = snapshot->user_settings;
+            g->current_cursor_focus = snapshot->current_cursor_focus;
+            g->start = snapshot->start, g->end = snapshot->end;
+            recovered = true;
+        }
+        if (snapshot != NULL)
+            free_gamestate(snapshot);
+    }
+    else
+        position = length;
+
+    // Replay whole frames only:
+    while (position < length && !error_code)
+    {
+        const unsigned char *next = image + position, *end = image + length;
+        uint32_t frame_length;
+        if (!read_varint(&next, end, &frame_length) || (size_t) (end - next) < (size_t) frame_length + JOURNAL_FRAME_CRC_SIZE)
+            break;
+        if (read_le32(next + frame_length) != crc32_update(0, next, frame_length) || !replay_journal_frame(g, next, frame_length))
+            break;
+        position = (size_t) (next - image) + frame_length + JOURNAL_FRAME_CRC_SIZE;
+        recovered = true;
+    }
+    free(image);
+    if (!recovered || error_code)
+        return free(path), false;
+
+    // A frame the crash cut short (or records that don't fit the map) may have left the view inconsistent:
+    unmark_outside_map(g);
+    Coordinates *cursor = &g->current_cursor_focus;
+    if (cursor->y_coordinate >= g->current_map->height)
+        cursor->y_coordinate = g->current_map->height - 1;
+    if (cursor->x_coordinate >= g->current_map->width)
+        cursor->x_coordinate = g->current_map->width - 1;
+    if (g->display->y_offset >= g->current_map->height)
+        g->display->y_offset = 0;
+    if (g->display->x_offset >= g->current_map->width)
+        g->display->x_offset = 0;
+
+    // The recovered edits are kept in the journal (until the map is saved, or the user quits without saving),
+    // but the next edit compacts it, as it may end in a torn frame:
+    rebase_journal(g, false, 0, 0);
+    g->journal.path = path;
+    g->saved = false;
+    return true;
+}
+
+/*********************************************************************************************
+ * savefile_v2_length:    Purpose: Finds where a v2 savefile ends within a longer image (the *
+ *                                 end of its last section), as when it begins a journal.    *
+ *                        Parameters: const unsigned char *image, size_t length -> the image *
+ *                        Return value: size_t -> the savefile's length (sections lying      *
+ *                                      outside the image are left for decoding to reject)   *
+ *                        Side effects: none                                                 *
+ *********************************************************************************************/
+size_t savefile_v2_length(const unsigned char *image, size_t length)
+{
+    size_t end = SAVEFILE_PREAMBLE_SIZE + (size_t) read_le16(image + 6) * SAVEFILE_SECTION_ENTRY_SIZE;
+    if (end > length)
+        return length;
+    for (size_t entry = SAVEFILE_PREAMBLE_SIZE; entry + SAVEFILE_SECTION_ENTRY_SIZE <= end; entry += SAVEFILE_SECTION_ENTRY_SIZE)
+    {
+        uint64_t offset = read_le64(image + entry + 8), size = read_le64(image + entry + 16);
+        if (offset <= length && size <= length - offset && offset + size > end)
+            end = (size_t) (offset + size);
+    }
+    return end;
+}
+
+/*********************************************************************************************
+ * replay_journal_frame:    Purpose: Applies one frame's records (see enum journal_records)  *
+ *                                   to the gamestate, checking each against the map first.  *
+ *                          Parameters: Gamestate *g -> the gamestate to apply them to       *
+ *                                      const unsigned char *bytes, size_t length -> the     *
+ *                                                                        frame's records    *
+ *                          Return value: bool -> false if a record is malformed (the        *
+ *                                        records before it have been applied)               *
+ *                          Side effects: - Edits the gamestate (may allocate tiles).        *
+ *                                        - Edits global variable "error_code"               *
+ *********************************************************************************************/
+bool replay_journal_frame(Gamestate *g, const unsigned char *bytes, size_t length)
+{
+    static const int value_counts[NUM_JOURNAL_RECORDS] = {3, 4, 5, 4, 2, 4, 4, 3};
+    const unsigned char *next = bytes, *end = bytes + length;
+    Map *m = g->current_map;
+    while (next < end)
+    {
+        int type = *next++;
+        if (type >= NUM_JOURNAL_RECORDS)
+            return false;
+        uint32_t v[MAX_JOURNAL_RECORD_VALUES];
+        for (int i = 0; i < value_counts[type]; i++)
+        {
+            if (!read_varint(&next, end, &v[i]))
+                return false;
+        }
+
+        uint32_t height = (uint32_t) m->height, width = (uint32_t) m->width;
+        switch (type)
+        {
+            case JOURNAL_ROOM:
+                if (v[0] >= height || v[1] >= width || v[2] > 1)
+                    return false;
+                set_room_exists(m, (int32_t) v[0], (int32_t) v[1], v[2]);
+                break;
+            case JOURNAL_EXIT:
+                if (v[0] >= height || v[1] >= width || v[2] >= NUM_CARDINAL_DIRECTIONS || v[3] > 1)
+                    return false;
+                set_room_exit(m, (int32_t) v[0], (int32_t) v[1], (int) v[2], v[3]);
+                break;
+            case JOURNAL_GROW:
+                if ((uint64_t) height + v[0] + v[2] > MAX_COORDINATE || (uint64_t) width + v[1] + v[3] > MAX_COORDINATE || v[4] > 1)
+                    return false;
+                grow_map(m, (int32_t) v[0], (int32_t) v[1], (int32_t) v[2], (int32_t) v[3], v[4]);
+                break;
+            case JOURNAL_SHRINK:
+                if ((uint64_t) v[0] + v[2] >= height || (uint64_t) v[1] + v[3] >= width)
+                    return false;
+                shrink_map(m, (int32_t) v[0], (int32_t) v[1], (int32_t) v[2], (int32_t) v[3]);
+                break;
+            case JOURNAL_CURSOR:
+                if (v[0] >= height || v[1] >= width)
+                    return false;
+                g->current_cursor_focus.y_coordinate = (int32_t) v[0], g->current_cursor_focus.x_coordinate = (int32_t) v[1];
+                break;
+            case JOURNAL_MARKS:
+            {
+                Coordinates marks[2];
+                for (int i = 0; i < 2; i++)
+                {
+                    uint32_t y = v[2 * i], x = v[2 * i + 1];
+                    if ((y == 0) != (x == 0) || y > height || x > width)
+                        return false;
+                    marks[i].y_coordinate = (int32_t) y - 1, marks[i].x_coordinate = (int32_t) x - 1;
+                }
+                g->start = marks[0], g->end = marks[1];
+                break;
+            }
+            case JOURNAL_DISPLAY:
+                if (v[0] < 1 || v[0] > MAX_COORDINATE || v[1] < 1 || v[1] > MAX_COORDINATE || v[2] >= height || v[3] >= width)
+                    return false;
+                g->display->height = (int) v[0], g->display->width = (int) v[1];
+                g->display->y_offset = (int32_t) v[2], g->display->x_offset = (int32_t) v[3];
+                break;
+            case JOURNAL_SETTINGS:
+                if (v[0] > 1 || v[1] < 1 || v[1] > MAX_COORDINATE || v[2] < 1 || v[2] > MAX_COORDINATE)
+                    return false;
+                g->user_settings->movement_mode = v[0] == 0 ? NESW : WASD;
+                g->user_settings->max_display_height = (int) v[1], g->user_settings->max_display_width = (int) v[2];
+                break;
+        }
+        if (error_code)
+            return false;
+    }
+    return true;
+}
+
+/*********************************************************************************************
+ * read_varint:    Purpose: Reads an unsigned integer stored 7 bits per byte, low bits       *
+ *                          first, with the top bit of each byte set if another follows.     *
+ *                 Parameters: const unsigned char **next -> the position to read from,      *
+ *                                                           advanced past the integer       *
+ *                             const unsigned char *end -> the end of the readable bytes     *
+ *                             uint32_t *value -> receives the integer                       *
+ *                 Return value: bool -> false if the integer is cut off or too long         *
+ *                 Side effects: none                                                        *
+ *********************************************************************************************/
+bool read_varint(const unsigned char **next, const unsigned char *end, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 7 * MAX_VARINT_SIZE && *next < end; shift += 7)
+    {
+        unsigned char byte = *(*next)++;
+        result |= (uint32_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+/********************************************************************************************
+ * edit_map:    Purpose: The bulk of the program. Allows the user to edit the passed map.   *
+ *              Parameters: Map *editable_map -> the map to be edited.                      *
+ *              Return value: Map * -> the now-edited map,                                  *
+ *                                     to be freed before further program operation         *
+ *                                     or program termination.                              *
+ *              Side effects: - Clears screen and scrollback                                *
+ *                            - Calls save_gamestate, which edits external files.                 *
+ *                            - Prints to stdout.                                           *
+ *                            - Reads from stdin.                                           *
+ *                            - Modifies any and all data associated with passed map.       *
+ ********************************************************************************************/
+Map *edit_map(Map *editable_map, Gamestate *current_gamestate)
+{
+    if (error_code) return editable_map;
+
+    Gamestate *gamestate;
+
+    if (current_gamestate == NULL) // If starting a new map, not loading one:
+    {
+        // Temp variables used for initialization purposes only:
+        Display *display;
+        Settings *settings;
+
+        // Create display and gamestate:
+        display = initialize_display(editable_map->height, editable_map->width);
+        if (error_code)
+        {
+            return editable_map;
+        }
+
+        settings = initialize_settings();
+        if (error_code)
+        {
+            free(display);
+        }
+
+        gamestate = initialize_gamestate(display, editable_map, settings);
+        if (error_code)
+        {
+            free(display);
+            free(settings);
+        }
+        // Now that gamestate has been created & initialized, the display/editable_map variables will no longer be used.
+        // For memory-management reasons, all access to displays/layouts/maps will be accomplished only via the gamestate structure.
+        // Otherwise, when new layouts/maps are created/destroyed during the course of subroutines, these old variables will still contain the
+        // *old* pointer addresses rather than the various newly-created/updated ones. Free()-ing is much easier if I can free everything via
+        // the gamestate variable instead. (The map is a special case, as the structure of the main menu requires the map to be passed to a
+        // free()-ing subroutine *after* this edit_map subroutine returns, so I will simply re-assign the editable_map variable to the newest
+        // map via gamestate just before freeing gamestate and returning editable_map. This weirdness is simply a consequence of my never having
+        // built a program this complex before; in future programs with similar goals, I will likely try to center all the structure around a
+        // gamestate from the very start, instead of centering around, say, a map, as here.)
+    }
+    else // If continuing a loaded file:
+    {
+        gamestate = current_gamestate;
+    }
+
+    // Record every edit from here on in the map's journal (see journal_command()):
+    gamestate->current_map->journal = &gamestate->journal;
+    remember_journal_view(gamestate);
+
+    // Interaction Loop:
+    for (;!gamestate->quit;)
+    {
+        CLEAR_CONSOLE;
+
+        // Print display:
+        print_display(gamestate);
+        if (error_code)
+        {
+            free(gamestate->display);
+            free(gamestate->user_settings);
+            editable_map = gamestate->current_map; // Re-establish map as its own variable so as to return and free it even once gamestate is already freed.
+            free_gamestate(gamestate);
+            return editable_map;
+        }
+
+        #ifdef FORCE_BUFFERED_MODE
+            obey_command(get_command("Enter command:\n>", gamestate, 'c'), gamestate);
+            journal_command(gamestate);
+            if (error_code)
+            {
+                    free(gamestate->display);
+                free(gamestate->user_settings);
+                editable_map = gamestate->current_map; // Re-establish map as its own variable so as to return and free it even once gamestate is already freed.
+                free_gamestate(gamestate);
+                return editable_map;
+            }
+            if (gamestate->quit && !gamestate->saved)
+                if (warn(gamestate))
+                    save_gamestate(gamestate);
+        #endif
+        #ifdef UNIX
+            //TODO
+        #endif
+        #ifdef WINDOWS
+            //TODO
+        #endif
+
+
+        // TODO: Print command prompt (incl "help for help")
+        // TODO: Accept input
+        // TODO: Parse user command
+        // TODO: Update program state based on command
+        // TODO: Update display based on updated state.
+        // TODO: Add save/quit functionality.
+    }
+
+    // Prompt for cursor start location (represented by *)
+    //  Alternately, start cursor on top line, furthest room to left.
+    // Allow commands for moving cursor cardinally ("move up")
+    // Allow commands for moving cursor cardinally while skipping over non-existent rooms ("skip up")
+    // Allow commands for cursor jumping ("jump to A3")
+    // Allow commands for establishing connecting doors between rooms (cardinally)
+    //      ...for now, force exit matching (eg, adding a north exit to a lower room forces a south exit to be added to the room above).
+    //        ...one day, this could be refactored to allow "warping" exits, but it'd probably be better to add that functionality w/ a proper GUI.
+    // Allow commands for removing connections
+    //      ...force destruction of matching exit (eg, removing a north exit forces removal of south exit from room above)
+    // Allow commands for expanding grid by x rows or columns
+    //      ...but ensure that this never expands past the MAX_COORDINATE limit.
+    // Allow commands for expanding grid by adding new individual rooms
+    //      ...but ensure that this never expands past the MAX_COORDINATE limit.
+    // Allow commands for deleting individual rooms
+    //      ...but ensure the row/column count stays above zero
+    // Allow commands for retracting grid by subtracting x rows or columns
+    //      ...but ensure the row/column count stays above zero
+    // Allow commands for establishing entrances and exits to maze (including interior ones)
+    // Allow commands for scrolling view of grid cardinally (in this case, meaning up, down, left, right)
+    // Let attempts at moving the cursor past the edges of the grid cause the grid to scroll (if there are rooms in that direction).
+    // Allow commands for saving maze to file and reading maze from file
+    // Allow commands for translating entire map plus or minus x x-values or y y-values
+    // Allow commands to establish critical path (in separate ANSI color)
+    // Allow command to highlight which rooms cannot be reached
+    // Allow command to determine whether critical path exists
+
+
+    //TODO: Allow saving map before returning (returning leads to freeing--aka losing--map from memory)
+    //TODO: Warns when about to return without saving
+    // Quitting normally leaves nothing to recover (the map was either saved or deliberately abandoned):
+    if (!error_code)
+        discard_journal(&gamestate->journal);
+    free(gamestate->display);
+    free(gamestate->user_settings);
+    editable_map = gamestate->current_map; // Re-establish map as its own variable so as to return and free it even once gamestate is already freed.
+    free_gamestate(gamestate);
+    return editable_map;
+}
+
+/****************************************************************************************************************
+ * initialize_display:        Purpose: Allocates room for, and initializes, a Display.                          *
+ *                            Parameters: int32_t map_height -> the height of the map to display                *
+ *                                        int32_t map_width -> the width of the map to display                  *
+ *                            Return value: Display * -> a pointer to the initialized Display                   *
+ *                            Side effects: - allocates memory                                                  *
+ *                                          - edits global variable "error_code"                                *
+ ****************************************************************************************************************/
+Display *initialize_display(int32_t map_height, int32_t map_width)
+{
+    Display *d = malloc(sizeof(Display));
+    if (d == NULL)
+    {
+        error_code = 6;
+        return NULL;
+    }
+
+    d->height = map_height > MAX_DISPLAY_HEIGHT ? MAX_DISPLAY_HEIGHT : map_height;
+    d->width = map_width > MAX_DISPLAY_WIDTH ? MAX_DISPLAY_WIDTH : map_width;
+    d->y_offset = 0, d->x_offset = 0;
+
+    return d;
+}
+
+Settings *initialize_settings(void)
+{
+    Settings *s = malloc(sizeof(Settings));
+    if (s == NULL)
     {
         error_code = 14;
         return NULL;
@@ -795,10 +2421,11 @@ Gamestate *initialize_gamestate(Display *display, Map *current_map, Settings *de
     g->saved = false;
     g->display = display;
     g->current_map = current_map;
-    g->current_cursor_focus = display->layout[0][0];
+    g->current_cursor_focus.y_coordinate = g->current_cursor_focus.x_coordinate = 0;
     g->user_settings = defaults;
-    g->start = g->end = NULL;
+    g->start = g->end = NO_ROOM;
     g->current_filename = NULL;
+    g->journal = (Journal) {0};
 
     return g;
 }
@@ -815,7 +2442,6 @@ void print_display(Gamestate *g)
 {
     // typedef struct display
     // {
-    //     Room ***layout;
     //     int height;
     //     int width;
     //     int32_t y_offset;
@@ -834,19 +2460,19 @@ void print_display(Gamestate *g)
 
     // Reset cursor if off display:
     int new_cursor_y = 0, new_cursor_x = 0;
-    if (g->current_cursor_focus->y_coordinate > g->display->height + g->display->y_offset - 1) // if below screen
+    if (g->current_cursor_focus.y_coordinate > g->display->height + g->display->y_offset - 1) // if below screen
         new_cursor_y = g->display->height + g->display->y_offset - 1;
-    else if (g->current_cursor_focus->y_coordinate < g->display->y_offset) // if above screen
+    else if (g->current_cursor_focus.y_coordinate < g->display->y_offset) // if above screen
         new_cursor_y = g->display->y_offset;
     else
-        new_cursor_y = g->current_cursor_focus->y_coordinate;
-    if (g->current_cursor_focus->x_coordinate > g->display->width + g->display->x_offset - 1) // if off-screen to the right
+        new_cursor_y = g->current_cursor_focus.y_coordinate;
+    if (g->current_cursor_focus.x_coordinate > g->display->width + g->display->x_offset - 1) // if off-screen to the right
         new_cursor_x = g->display->width + g->display->x_offset - 1;
-    else if (g->current_cursor_focus->x_coordinate < g->display->x_offset) // if off-screen to the left
+    else if (g->current_cursor_focus.x_coordinate < g->display->x_offset) // if off-screen to the left
         new_cursor_x = g->display->x_offset;
     else
-        new_cursor_x = g->current_cursor_focus->x_coordinate;
-    g->current_cursor_focus = g->display->layout[new_cursor_y][new_cursor_x];
+        new_cursor_x = g->current_cursor_focus.x_coordinate;
+    g->current_cursor_focus.y_coordinate = new_cursor_y, g->current_cursor_focus.x_coordinate = new_cursor_x;
 
     // Find max screen length of y-coordinates to display, for formatting purposes:
     char *longest_y_string = ystr(g->display->height - 1 + g->display->y_offset);
@@ -864,6 +2490,9 @@ void print_display(Gamestate *g)
     int assumed_terminal_width_in_cols = g->user_settings->max_display_width * min_cell_width;
     if (assumed_terminal_width_in_cols < g->display->width * cell_width)
         g->display->width = assumed_terminal_width_in_cols / cell_width;
+    // Scroll rather than lose the cursor if that narrowed the display (eg, far to the east, where x-coordinates are long):
+    if (g->current_cursor_focus.x_coordinate > g->display->x_offset + g->display->width - 1)
+        g->display->x_offset = g->current_cursor_focus.x_coordinate - (g->display->width - 1);
     int room_width = 3;
     int hyphens = cell_width - room_width;
     int left_hyphens = hyphens / 2;
@@ -895,7 +2524,7 @@ void print_display(Gamestate *g)
             error_code = 7;
             return;
         }
-        (void) snprintf(x_str, sizeof(x_str), "%d", x + g->display->x_offset);
+        (void) snprintf(x_str, needed_strlen + 1, "%d", x + g->display->x_offset);
         // Print centered x-coordinate string:
         if (cell_width == needed_strlen + space_on_both_sides)
             (void) printf(" %s ", x_str), free(x_str);
@@ -928,17 +2557,11 @@ void print_display(Gamestate *g)
             for (int hyphen = 0; hyphen < left_hyphens + 1; hyphen++) // + 1 is for the left parenthesis of the room.
                 (void) printf(" ");
 
-            // Find pointer to room matching current coordinates:
-            Room *current = g->display->layout[y + g->display->y_offset][x + g->display->x_offset];
-            if (current == NULL)
-            {
-                error_code = 1;
-                return;
-            }
+            // Coordinates of the room being printed:
+            Coordinates current = {y + g->display->y_offset, x + g->display->x_offset};
 
-            // Print either passageway or spaces depending on north exit per room
-            //      (this code assumes a north exit always corresponds with a south exit above):
-            if (current->exists && current->exits[NORTH])
+            // Print either passageway or spaces depending on north exit per room:
+            if (room_exists(g->current_map, current.y_coordinate, current.x_coordinate) && room_exit(g->current_map, current.y_coordinate, current.x_coordinate, NORTH))
                 (void) printf("|");
             else
                 (void) printf(" ");
@@ -960,41 +2583,35 @@ void print_display(Gamestate *g)
         // Print visible rooms:
         for (int x = 0; x < g->display->width; x++)
         {
-            // Find pointer to room matching current coordinates:
-            Room *current = g->display->layout[y + g->display->y_offset][x + g->display->x_offset];
-            if (current == NULL)
-            {
-                error_code = 1;
-                return;
-            }
-            // Print either left hyphens or spaces depending on east exit per room
-            //      (this code assumes an east exit always corresponds with a west exit to the left):
+            // Coordinates of the room being printed:
+            Coordinates current = {y + g->display->y_offset, x + g->display->x_offset};
+            bool current_exists = room_exists(g->current_map, current.y_coordinate, current.x_coordinate);
+            // Print either left hyphens or spaces depending on west exit per room:
             for (int hyphen = 0; hyphen < left_hyphens; hyphen++)
-                if (current->exists && current->exits[WEST])
+                if (current_exists && room_exit(g->current_map, current.y_coordinate, current.x_coordinate, WEST))
                     (void) printf("-");
                 else
                     (void) printf(" ");
 
             // Print room (if existent), with cursor if that's where the cursor is:
-            if (current->exists)
+            if (current_exists)
                 (void) printf("(");
             else
                 (void) printf(" ");
-            if (current == g->current_cursor_focus)
+            if (same_room(current, g->current_cursor_focus))
                 (void) printf("*");
-            else if (current->mark)
-                (void) printf("%c", current->mark);
+            else if (room_mark(g, current))
+                (void) printf("%c", room_mark(g, current));
             else
                 (void) printf(" ");
-            if (current->exists)
+            if (current_exists)
                 (void) printf(")");
             else
                 (void) printf(" ");
 
-            // Print either right hyphens or spaces depending on west exit per room
-            //      (this code assumes a west exit always corresponds with an east exit to the right):
+            // Print either right hyphens or spaces depending on east exit per room:
             for (int hyphen = 0; hyphen < right_hyphens; hyphen++)
-                if (current->exists && current->exits[EAST])
+                if (current_exists && room_exit(g->current_map, current.y_coordinate, current.x_coordinate, EAST))
                     (void) printf("-");
                 else
                     (void) printf(" ");
@@ -1014,16 +2631,10 @@ void print_display(Gamestate *g)
                 // Print spaces where left hyphens & left side of room would be on room line:
                 for (int hyphen = 0; hyphen < left_hyphens + 1; hyphen++) // + 1 is for the left parenthesis of the room.
                     (void) printf(" ");
-                // Find pointer to room matching current coordinates:
-                Room *current = g->display->layout[y + g->display->y_offset][x + g->display->x_offset];
-                if (current == NULL)
-                {
-                    error_code = 1;
-                    return;
-                }
-                // Print either passageway or spaces depending on north exit per room
-                //      (this code assumes a south exit always corresponds with a north exit below):
-                if (current->exists && current->exits[SOUTH])
+                // Coordinates of the room being printed:
+                Coordinates current = {y + g->display->y_offset, x + g->display->x_offset};
+                // Print either passageway or spaces depending on south exit per room:
+                if (room_exists(g->current_map, current.y_coordinate, current.x_coordinate) && room_exit(g->current_map, current.y_coordinate, current.x_coordinate, SOUTH))
                     (void) printf("|");
                 else
                     (void) printf(" ");
@@ -1211,6 +2822,7 @@ int parse_command(char *command, Gamestate *g)
     // Initialize variables necessary for parsing:
     int32_t user_display_rows = 0, user_display_columns = 0; // Needed to parse user's display commands.
     char *letter_coordinate_holder = NULL, *number_coordinate_holder = NULL; // Needed to parse user's jump commands.
+    int32_t add_count = 0; int add_direction = NORTH; // Needed to parse user's bulk add commands.
 
     // String comparisons and code returns:
     if (caseless_strcmp("help", command) || caseless_strcmp("h", command))
@@ -1269,8 +2881,16 @@ int parse_command(char *command, Gamestate *g)
         return g->saved = false, 27;
     else if (caseless_strcmp("remove column west", command) || caseless_strcmp("remove column w", command) || caseless_strcmp("remove w", command) || caseless_strcmp("rem w", command))
         return g->saved = false, 28;
-    else if (display_strcmp(command, &user_display_rows, &user_display_columns))
+    else if (dimensions_strcmp(command, "display ", &user_display_rows, &user_display_columns))
         return g->saved = false, handle_display_command(g, user_display_rows, user_display_columns);
+    else if (dimensions_strcmp(command, "resize ", &user_display_rows, &user_display_columns))
+        return g->saved = false, handle_resize_command(g, user_display_rows, user_display_columns, false);
+    else if (dimensions_strcmp(command, "resize blank ", &user_display_rows, &user_display_columns))
+        return g->saved = false, handle_resize_command(g, user_display_rows, user_display_columns, true);
+    else if (add_strcmp(command, "add ", &add_count, &add_direction))
+        return g->saved = false, handle_add_command(g, add_count, add_direction, false);
+    else if (add_strcmp(command, "add blank ", &add_count, &add_direction))
+        return g->saved = false, handle_add_command(g, add_count, add_direction, true);
     else if (jump_strcmp(command, &letter_coordinate_holder, &number_coordinate_holder))
         return g->saved = false, handle_jump_command(g, letter_coordinate_holder, number_coordinate_holder);
     else
@@ -1291,17 +2911,16 @@ int caseless_strcmp(char *str1, char *str2)
     return 1;
 }
 
-int display_strcmp(char *command, int32_t *user_display_rows, int32_t *user_display_columns)
+int dimensions_strcmp(char *command, char *needed_start, int32_t *user_rows, int32_t *user_columns)
 {
-    // "display #x#" is at least MIN_DISPLAY_COMMAND_LENGTH chars long:
+    // "<needed_start>#x#" (eg, "display #x#") is at least MIN_DIMENSIONS_LENGTH chars longer than needed_start:
     int n = strlen(command);
-    if (n < MIN_DISPLAY_COMMAND_LENGTH)
+    int n2 = strlen(needed_start);
+    if (n < n2 + MIN_DIMENSIONS_LENGTH)
         return 0;
 
     // Make sure command matches the necessary model (while also preparing to convert user dimensions to ints):
     //      First section:
-    char *needed_start = "display ";
-    int n2 = strlen(needed_start);
     int index = 0, y_index = 0, x_index = 0;
     bool leading_zero = false;
     for (; index < n2; index++)
@@ -1373,21 +2992,21 @@ int display_strcmp(char *command, int32_t *user_display_rows, int32_t *user_disp
     int max_len = strlen(INT32_MAXIMUM_STRING);
     int y_len = strlen(y_dim_chars), x_len = strlen(x_dim_chars);
     if (y_len > max_len)
-        *user_display_rows = INT32_MAX;
+        *user_rows = INT32_MAX;
     else if (y_len < max_len)
     {
         // Convert input:
         int32_t typecast = 0;
         for (i = 0; i < y_len; i++)
             typecast += (y_dim_chars[(y_len - 1) - i] - '0') * (pow(10, i));
-        *user_display_rows = typecast;
+        *user_rows = typecast;
     }
     else // same length
     {
         for (i = 0; i < max_len; i++)
             if (y_dim_chars[i] - '0' > INT32_MAXIMUM_STRING[i] - '0')
             {
-                *user_display_rows = INT32_MAX;
+                *user_rows = INT32_MAX;
                 too_big = true;
                 break;
             }
@@ -1410,26 +3029,26 @@ int display_strcmp(char *command, int32_t *user_display_rows, int32_t *user_disp
             int32_t typecast = 0;
             for (i = 0; i < y_len; i++)
                 typecast += (y_dim_chars[(y_len - 1) - i] - '0') * (pow(10, i));
-            *user_display_rows = typecast;
+            *user_rows = typecast;
         }
     }
     too_big = false;
     if (x_len > max_len)
-        *user_display_columns = INT32_MAX;
+        *user_columns = INT32_MAX;
     else if (x_len < max_len)
     {
         // Convert input:
         int32_t typecast = 0;
         for (i = 0; i < x_len; i++)
             typecast += (x_dim_chars[(x_len - 1) - i] - '0') * (pow(10, i));
-        *user_display_columns = typecast;
+        *user_columns = typecast;
     }
     else // same length
     {
         for (i = 0; i < max_len; i++)
             if (x_dim_chars[i] - '0' > INT32_MAXIMUM_STRING[i] - '0')
             {
-                *user_display_columns = INT32_MAX;
+                *user_columns = INT32_MAX;
                 too_big = true;
                 break;
             }
@@ -1439,7 +3058,7 @@ int display_strcmp(char *command, int32_t *user_display_rows, int32_t *user_disp
             int32_t typecast = 0;
             for (i = 0; i < x_len; i++)
                 typecast += (x_dim_chars[(x_len - 1) - i] - '0') * (pow(10, i));
-            *user_display_columns = typecast;
+            *user_columns = typecast;
         }
     }
 
@@ -1465,6 +3084,109 @@ int handle_display_command(Gamestate *g, int32_t user_rows, int32_t user_columns
     return -1;
 }
 
+/**********************************************************************************************************
+ * handle_resize_command:    Purpose: Resizes the map to exactly user_rows x user_columns in one step,    *
+ *                                    adding/removing rows on the south side and columns on the east.     *
+ *                           Parameters: Gamestate *g -> the gamestate containing the map to resize       *
+ *                                       int32_t user_rows, user_columns -> the requested map size        *
+ *                                       bool blank -> whether added rooms start out deleted              *
+ *                           Return value: int -> command code (-1 on success, else a message code)       *
+ *                           Side effects: - Edits the map, cursor, marks and display.                    *
+ *                                         - Edits global variable "error_code"                           *
+ **********************************************************************************************************/
+int handle_resize_command(Gamestate *g, int32_t user_rows, int32_t user_columns, bool blank)
+{
+    // Check bounds once, up front, for the whole batch:
+    if (user_rows == 0 || user_columns == 0)
+        return 33;
+    if (user_rows > MAX_COORDINATE || user_columns > MAX_COORDINATE)
+        return 34;
+
+    // Remove whatever is no longer wanted first, so the growth below only reserves what is actually needed:
+    int32_t rows_to_remove = g->current_map->height > user_rows ? g->current_map->height - user_rows : 0;
+    int32_t columns_to_remove = g->current_map->width > user_columns ? g->current_map->width - user_columns : 0;
+    if (rows_to_remove || columns_to_remove)
+    {
+        shrink_map(g->current_map, 0, columns_to_remove, rows_to_remove, 0);
+        unmark_outside_map(g);
+        if (g->current_cursor_focus.y_coordinate >= g->current_map->height)
+            g->current_cursor_focus.y_coordinate = g->current_map->height - 1;
+        if (g->current_cursor_focus.x_coordinate >= g->current_map->width)
+            g->current_cursor_focus.x_coordinate = g->current_map->width - 1;
+    }
+
+    // Add everything that is wanted in a single pass:
+    add_rows_and_columns(g, 0, user_columns - g->current_map->width, user_rows - g->current_map->height, 0, blank);
+    return -1;
+}
+
+/**********************************************************************************************************
+ * add_strcmp:    Purpose: Checks whether the command is a bulk add command                               *
+ *                         ("<needed_start><count> rows north/south" or "... columns east/west",          *
+ *                         where the direction may also be abbreviated to n/e/s/w).                       *
+ *                Parameters: char *command -> the user's command                                         *
+ *                            char *needed_start -> the command's expected start (eg, "add ")             *
+ *                            int32_t *count -> set to the number of rows/columns to add                  *
+ *                            int *direction -> set to the cardinal direction to add them in              *
+ *                Return value: int -> 1 if the command matched, else 0                                   *
+ *                Side effects: none                                                                      *
+ **********************************************************************************************************/
+int add_strcmp(char *command, char *needed_start, int32_t *count, int *direction)
+{
+    int index = 0, n = strlen(needed_start);
+    for (; index < n; index++)
+    {
+        if (needed_start[index] != tolower(command[index]))
+            return 0;
+    }
+
+    // Count (no leading zeroes; anything too large for an int32 is clamped, to be rejected by MAX_COORDINATE later):
+    if (!isdigit(command[index]) || (command[index] == '0' && isdigit(command[index + 1])))
+        return 0;
+    int64_t parsed = 0;
+    for (; isdigit(command[index]); index++)
+    {
+        parsed = parsed * 10 + (command[index] - '0');
+        if (parsed > INT32_MAX)
+            parsed = INT32_MAX;
+    }
+    if (command[index++] != ' ')
+        return 0;
+
+    // Rows/columns and direction:
+    char *rest = command + index;
+    if (caseless_strcmp("rows north", rest) || caseless_strcmp("rows n", rest) || caseless_strcmp("n", rest))
+        *direction = NORTH;
+    else if (caseless_strcmp("columns east", rest) || caseless_strcmp("columns e", rest) || caseless_strcmp("e", rest))
+        *direction = EAST;
+    else if (caseless_strcmp("rows south", rest) || caseless_strcmp("rows s", rest) || caseless_strcmp("s", rest))
+        *direction = SOUTH;
+    else if (caseless_strcmp("columns west", rest) || caseless_strcmp("columns w", rest) || caseless_strcmp("w", rest))
+        *direction = WEST;
+    else
+        return 0;
+
+    *count = (int32_t) parsed;
+    return 1;
+}
+
+int handle_add_command(Gamestate *g, int32_t count, int direction, bool blank)
+{
+    // Check bounds once, up front, for the whole batch:
+    int32_t current_size = direction == NORTH || direction == SOUTH ? g->current_map->height : g->current_map->width;
+    if (count > MAX_COORDINATE - current_size)
+        return 34;
+
+    switch (direction)
+    {
+        case NORTH: add_rows_and_columns(g, count, 0, 0, 0, blank); break;
+        case EAST: add_rows_and_columns(g, 0, count, 0, 0, blank); break;
+        case SOUTH: add_rows_and_columns(g, 0, 0, count, 0, blank); break;
+        case WEST: add_rows_and_columns(g, 0, 0, 0, count, blank); break;
+    }
+    return -1;
+}
+
 int jump_strcmp(char *command, char **letter_coordinate, char **number_coordinate)
 {
     int n = strlen(command);
@@ -1613,17 +3335,17 @@ int handle_jump_command(Gamestate *g, char *letter_coordinate, char *number_coor
         return 32;
 
     // Assign cursor to new valid coordinates:
-    g->current_cursor_focus = g->display->layout[converted_letter_coordinate][converted_number_coordinate];
+    g->current_cursor_focus.y_coordinate = converted_letter_coordinate, g->current_cursor_focus.x_coordinate = converted_number_coordinate;
 
     // Change display offsets to reach new cursor:
-    if (g->current_cursor_focus->y_coordinate < g->display->y_offset)
-        g->display->y_offset = g->current_cursor_focus->y_coordinate;
-    else if (g->current_cursor_focus->y_coordinate > g->display->y_offset + (g->display->height - 1))
-        g->display->y_offset = (g->display->height - 1) + g->current_cursor_focus->y_coordinate;
-    if (g->current_cursor_focus->x_coordinate < g->display->x_offset)
-        g->display->x_offset = g->current_cursor_focus->x_coordinate;
-    else if (g->current_cursor_focus->x_coordinate > g->display->x_offset + (g->display->width - 1))
-        g->display->x_offset = (g->display->width - 1) + g->current_cursor_focus->x_coordinate;
+    if (g->current_cursor_focus.y_coordinate < g->display->y_offset)
+        g->display->y_offset = g->current_cursor_focus.y_coordinate;
+    else if (g->current_cursor_focus.y_coordinate > g->display->y_offset + (g->display->height - 1))
+        g->display->y_offset = g->current_cursor_focus.y_coordinate - (g->display->height - 1);
+    if (g->current_cursor_focus.x_coordinate < g->display->x_offset)
+        g->display->x_offset = g->current_cursor_focus.x_coordinate;
+    else if (g->current_cursor_focus.x_coordinate > g->display->x_offset + (g->display->width - 1))
+        g->display->x_offset = g->current_cursor_focus.x_coordinate - (g->display->width - 1);
 
     return -1;
 }
@@ -1676,14 +3398,14 @@ void obey_command(int command_code, Gamestate *g)
         case 10: mark(0, g); break;
         case 11: delete(g); break;
         case 12: undelete(g); break;
-        case 13: open(g, NORTH); break;
-        case 14: open(g, EAST); break;
-        case 15: open(g, SOUTH); break;
-        case 16: open(g, WEST); break;
-        case 17: close(g, NORTH); break;
-        case 18: close(g, EAST); break;
-        case 19: close(g, SOUTH); break;
-        case 20: close(g, WEST); break;
+        case 13: open_exit(g, NORTH); break;
+        case 14: open_exit(g, EAST); break;
+        case 15: open_exit(g, SOUTH); break;
+        case 16: open_exit(g, WEST); break;
+        case 17: close_exit(g, NORTH); break;
+        case 18: close_exit(g, EAST); break;
+        case 19: close_exit(g, SOUTH); break;
+        case 20: close_exit(g, WEST); break;
         case 21: add_row_north(g); break;
         case 22: add_column_east(g); break;
         case 23: add_row_south(g); break;
@@ -1696,6 +3418,8 @@ void obey_command(int command_code, Gamestate *g)
         case 30: (void) printf("Unable to jump: the given y- and x- coordinates are off the map.\n"), gobble_line(); break;
         case 31: (void) printf("Unable to jump: the given y-coordinate is off the map.\n"), gobble_line(); break;
         case 32: (void) printf("Unable to jump: the given x-coordinate is off the map.\n"), gobble_line(); break;
+        case 33: (void) printf("Map must be at least 1x1.\n"), gobble_line(); break;
+        case 34: (void) printf("Unable to comply: Resizing would exceed maximum possible map size.\n"), gobble_line(); break;
     }
 }
 
@@ -1720,6 +3444,10 @@ void print_command_listing(Gamestate *g)
                     "\tAdd column east / west (or add e/w): Creates a new map column in the specified direction\n"
                     "\tRemove row north / south (or rem n/s): Removes the furthest map row in the specified direction\n"
                     "\tRemove column east / west (or rem e/w): Removes the furthest map column in the specified direction\n"
+                    "\tAdd <count> rows north / south (or add <count> n/s): Creates <count> new map rows in the specified direction\n"
+                    "\tAdd <count> columns east / west (or add <count> e/w): Creates <count> new map columns in the specified direction\n"
+                    "\tResize <rows>x<columns>: Adds/removes rows to the south and columns to the east until the map is the given size\n"
+                    "\tAdd blank ... / Resize blank ...: As above, but the new rooms start out deleted (and take up no memory until drawn)\n"
                     "Settings commands:\n"
                     "\tDisplay <rows>x<columns>: Adjusts the maximum display size\n");
     if (g->user_settings->movement_mode == NESW)
@@ -1757,7 +3485,7 @@ void move_cursor(int cardinal_direction, Gamestate *g)
     int yesno = '\0';
 
     //Check if moving cursor would place if off the current layout:
-    if (cardinal_direction == NORTH && g->current_cursor_focus->y_coordinate == 0) // NORTH LAYOUT EDGE
+    if (cardinal_direction == NORTH && g->current_cursor_focus.y_coordinate == 0) // NORTH LAYOUT EDGE
     {
         #ifdef FORCE_BUFFERED_MODE
             do
@@ -1778,7 +3506,7 @@ void move_cursor(int cardinal_direction, Gamestate *g)
             add_row_north(g);
         }
     }
-    else if (cardinal_direction == EAST && g->current_cursor_focus->x_coordinate == (g->current_map->width - 1)) // EAST LAYOUT EDGE
+    else if (cardinal_direction == EAST && g->current_cursor_focus.x_coordinate == (g->current_map->width - 1)) // EAST LAYOUT EDGE
     {
         #ifdef FORCE_BUFFERED_MODE
             do
@@ -1798,11 +3526,11 @@ void move_cursor(int cardinal_direction, Gamestate *g)
         {
             add_column_east(g);
             // Move the display if display cannot grow:
-            if (g->display->width == g->user_settings->max_display_width && g->current_cursor_focus->x_coordinate == (g->display->width - 1) + g->display->x_offset)
+            if (g->display->width == g->user_settings->max_display_width && g->current_cursor_focus.x_coordinate == (g->display->width - 1) + g->display->x_offset)
                 g->display->x_offset++;
         }
     }
-    else if (cardinal_direction == SOUTH && g->current_cursor_focus->y_coordinate == (g->current_map->height - 1)) // SOUTH LAYOUT EDGE
+    else if (cardinal_direction == SOUTH && g->current_cursor_focus.y_coordinate == (g->current_map->height - 1)) // SOUTH LAYOUT EDGE
     {
         #ifdef FORCE_BUFFERED_MODE
             do
@@ -1822,11 +3550,11 @@ void move_cursor(int cardinal_direction, Gamestate *g)
         {
             add_row_south(g);
             // Move the display if display cannot grow:
-            if (g->display->height == g->user_settings->max_display_height && g->current_cursor_focus->y_coordinate == (g->display->height - 1) + g->display->y_offset)
+            if (g->display->height == g->user_settings->max_display_height && g->current_cursor_focus.y_coordinate == (g->display->height - 1) + g->display->y_offset)
                 g->display->y_offset++;
         }
     }
-    else if (cardinal_direction == WEST && g->current_cursor_focus->x_coordinate == 0) // WEST LAYOUT EDGE
+    else if (cardinal_direction == WEST && g->current_cursor_focus.x_coordinate == 0) // WEST LAYOUT EDGE
     {
         #ifdef FORCE_BUFFERED_MODE
             do
@@ -1848,33 +3576,33 @@ void move_cursor(int cardinal_direction, Gamestate *g)
         }
     }
     //Check if moving cursor would place it off the current display:
-    else if (cardinal_direction == NORTH && g->current_cursor_focus->y_coordinate == g->display->y_offset) // NORTH DISPLAY EDGE
+    else if (cardinal_direction == NORTH && g->current_cursor_focus.y_coordinate == g->display->y_offset) // NORTH DISPLAY EDGE
     {
         // Move the display:
         g->display->y_offset--;
         // Move the cursor:
-        g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate - 1][g->current_cursor_focus->x_coordinate];
+        g->current_cursor_focus.y_coordinate--;
     }
-    else if (cardinal_direction == EAST && g->current_cursor_focus->x_coordinate == g->display->x_offset + (g->display->width - 1)) // EAST DISPLAY EDGE
+    else if (cardinal_direction == EAST && g->current_cursor_focus.x_coordinate == g->display->x_offset + (g->display->width - 1)) // EAST DISPLAY EDGE
     {
         // Move the display:
         g->display->x_offset++;
         // Move the cursor:
-        g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate + 1];
+        g->current_cursor_focus.x_coordinate++;
     }
-    else if (cardinal_direction == SOUTH && g->current_cursor_focus->y_coordinate == g->display->y_offset + (g->display->height - 1)) // SOUTH DISPLAY EDGE
+    else if (cardinal_direction == SOUTH && g->current_cursor_focus.y_coordinate == g->display->y_offset + (g->display->height - 1)) // SOUTH DISPLAY EDGE
     {
         // Move the display:
         g->display->y_offset++;
         // Move the cursor:
-        g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate + 1][g->current_cursor_focus->x_coordinate];
+        g->current_cursor_focus.y_coordinate++;
     }
-    else if (cardinal_direction == WEST && g->current_cursor_focus->x_coordinate == g->display->x_offset) // WEST DISPLAY EDGE
+    else if (cardinal_direction == WEST && g->current_cursor_focus.x_coordinate == g->display->x_offset) // WEST DISPLAY EDGE
     {
         // Move the display:
         g->display->x_offset--;
         // Move the cursor:
-        g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate - 1];
+        g->current_cursor_focus.x_coordinate--;
     }
     else // No need to adjust layout or display; just move the cursor:
     {
@@ -1882,13 +3610,13 @@ void move_cursor(int cardinal_direction, Gamestate *g)
         {
             default: error_code = 12; break;
             case NORTH:
-                g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate - 1][g->current_cursor_focus->x_coordinate]; break;
+                g->current_cursor_focus.y_coordinate--; break;
             case EAST:
-                g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate + 1]; break;
+                g->current_cursor_focus.x_coordinate++; break;
             case SOUTH:
-                g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate + 1][g->current_cursor_focus->x_coordinate]; break;
+                g->current_cursor_focus.y_coordinate++; break;
             case WEST:
-                g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate - 1]; break;
+                g->current_cursor_focus.x_coordinate--; break;
         }
     }
 
@@ -1897,243 +3625,83 @@ void move_cursor(int cardinal_direction, Gamestate *g)
 
 void add_row_north(Gamestate *g)
 {
-    // Store cursor position, adjusted inward if on southern end of map (to prevent cursor falling out of display after row is added):
-    int32_t cursor_y = g->current_cursor_focus->y_coordinate == (g->display->height - 1) + g->display->y_offset ? g->current_cursor_focus->y_coordinate - 1 : g->current_cursor_focus->y_coordinate;
-    int32_t cursor_x = g->current_cursor_focus->x_coordinate;
-
-    Dimensions new_map_dim;
-    new_map_dim.height = g->current_map->height + 1;
-    new_map_dim.width = g->current_map->width;
-
-    if (new_map_dim.height > MAX_COORDINATE)
+    if (g->current_map->height + 1 > MAX_COORDINATE)
     {
         (void) printf("Unable to comply: Adding new row would exceed maximum possible map size.\n");
         return;
     }
 
-    Map *new_map = create_map(new_map_dim);
-    if (error_code)
-        return;
-
-    Room ***new_layout = create_initial_layout(new_map);
-    if (error_code)
-    {
-        free_layout(new_layout, new_map_dim.height);
-        free_map(new_map);
-        return;
-    }
-
-    // Transfer established Room properties:
-    for (int32_t row = 0; row < g->current_map->height; row++)
-    {
-        for (int32_t column = 0; column < g->current_map->width; column++)
-        {
-            new_layout[row + 1][column]->exists = g->display->layout[row][column]->exists;
-            new_layout[row + 1][column]->mark = g->display->layout[row][column]->mark;
-            for (int cardinal_direction = NORTH; cardinal_direction < NUM_CARDINAL_DIRECTIONS; cardinal_direction++)
-            {
-                new_layout[row + 1][column]->exits[cardinal_direction] = g->display->layout[row][column]->exits[cardinal_direction];
-            }
-        }
-    }
-
-    // Transfer marked rooms:
-    if (g->start)
-        g->start = new_layout[g->start->y_coordinate + 1][g->start->x_coordinate];
-    if (g->end)
-        g->end = new_layout[g->end->y_coordinate + 1][g->end->x_coordinate];
-
-    free_layout(g->display->layout, g->current_map->height);
-    free_map(g->current_map);
-    g->display->layout = new_layout;
-    g->current_map = new_map;
-    g->current_cursor_focus = g->display->layout[cursor_y + 1][cursor_x];
-
-    // Resize display:
-    if (g->display->height < g->current_map->height && g->current_map->height <= g->user_settings->max_display_height)
-        g->display->height = g->current_map->height, g->display->y_offset = 0;
-
+    add_rows_and_columns(g, 1, 0, 0, 0, false);
     return;
 }
 
 void add_column_east(Gamestate *g)
 {
-    // Store cursor position:
-    int32_t cursor_y = g->current_cursor_focus->y_coordinate;
-    int32_t cursor_x = g->current_cursor_focus->x_coordinate;
-
-    Dimensions new_map_dim;
-    new_map_dim.height = g->current_map->height;
-    new_map_dim.width = g->current_map->width + 1;
-
-    if (new_map_dim.width > MAX_COORDINATE)
+    if (g->current_map->width + 1 > MAX_COORDINATE)
     {
         (void) printf("Unable to comply: Adding new column would exceed maximum possible map size.\n");
         return;
     }
 
-    Map *new_map = create_map(new_map_dim);
-    if (error_code)
-        return;
-
-    Room ***new_layout = create_initial_layout(new_map);
-    if (error_code)
-    {
-        free_layout(new_layout, new_map_dim.height);
-        free_map(new_map);
-        return;
-    }
-
-    // Transfer established Room properties:
-    for (int32_t row = 0; row < g->current_map->height; row++)
-    {
-        for (int32_t column = 0; column < g->current_map->width; column++)
-        {
-            new_layout[row][column]->exists = g->display->layout[row][column]->exists;
-            new_layout[row][column]->mark = g->display->layout[row][column]->mark;
-            for (int cardinal_direction = NORTH; cardinal_direction < NUM_CARDINAL_DIRECTIONS; cardinal_direction++)
-            {
-                new_layout[row][column]->exits[cardinal_direction] = g->display->layout[row][column]->exits[cardinal_direction];
-            }
-        }
-    }
-
-    // Transfer marked rooms:
-    if (g->start)
-        g->start = new_layout[g->start->y_coordinate][g->start->x_coordinate];
-    if (g->end)
-        g->end = new_layout[g->end->y_coordinate][g->end->x_coordinate];
-
-    free_layout(g->display->layout, g->current_map->height);
-    free_map(g->current_map);
-    g->display->layout = new_layout;
-    g->current_map = new_map;
-    g->current_cursor_focus = g->display->layout[cursor_y][cursor_x];
-
-    // Resize display:
-    if (g->display->width < g->current_map->width && g->current_map->width <= g->user_settings->max_display_width)
-        g->display->width = g->current_map->width, g->display->x_offset = 0;
-
+    add_rows_and_columns(g, 0, 1, 0, 0, false);
     return;
 }
 
 void add_row_south(Gamestate *g)
 {
-    // Store cursor position:
-    int32_t cursor_y = g->current_cursor_focus->y_coordinate;
-    int32_t cursor_x = g->current_cursor_focus->x_coordinate;
-
-    Dimensions new_map_dim;
-    new_map_dim.height = g->current_map->height + 1;
-    new_map_dim.width = g->current_map->width;
-
-    if (new_map_dim.height > MAX_COORDINATE)
+    if (g->current_map->height + 1 > MAX_COORDINATE)
     {
         (void) printf("Unable to comply: Adding new row would exceed maximum possible map size.\n");
         return;
     }
 
-    Map *new_map = create_map(new_map_dim);
-    if (error_code)
-        return;
-
-    Room ***new_layout = create_initial_layout(new_map);
-    if (error_code)
-    {
-        free_layout(new_layout, new_map_dim.height);
-        free_map(new_map);
-        return;
-    }
-
-    // Transfer established Room properties:
-    for (int32_t row = 0; row < g->current_map->height; row++)
-    {
-        for (int32_t column = 0; column < g->current_map->width; column++)
-        {
-            new_layout[row][column]->exists = g->display->layout[row][column]->exists;
-            new_layout[row][column]->mark = g->display->layout[row][column]->mark;
-            for (int cardinal_direction = NORTH; cardinal_direction < NUM_CARDINAL_DIRECTIONS; cardinal_direction++)
-            {
-                new_layout[row][column]->exits[cardinal_direction] = g->display->layout[row][column]->exits[cardinal_direction];
-            }
-        }
-    }
-
-    // Transfer marked rooms:
-    if (g->start)
-        g->start = new_layout[g->start->y_coordinate][g->start->x_coordinate];
-    if (g->end)
-        g->end = new_layout[g->end->y_coordinate][g->end->x_coordinate];
-
-    free_layout(g->display->layout, g->current_map->height);
-    free_map(g->current_map);
-    g->display->layout = new_layout;
-    g->current_map = new_map;
-    g->current_cursor_focus = g->display->layout[cursor_y][cursor_x];
-
-    // Resize display:
-    if (g->display->height < g->current_map->height && g->current_map->height <= g->user_settings->max_display_height)
-        g->display->height = g->current_map->height, g->display->y_offset = 0;
-
+    add_rows_and_columns(g, 0, 0, 1, 0, false);
     return;
 }
 
 void add_column_west(Gamestate *g)
 {
-    // Store cursor position, adjusted inward if on eastern end of map (to prevent cursor moving out of display after column is added):
-    int32_t cursor_y = g->current_cursor_focus->y_coordinate;
-    int32_t cursor_x = g->current_cursor_focus->x_coordinate == (g->display->width - 1) + g->display->x_offset ? g->current_cursor_focus->x_coordinate - 1 : g->current_cursor_focus->x_coordinate;
-
-    Dimensions new_map_dim;
-    new_map_dim.height = g->current_map->height;
-    new_map_dim.width = g->current_map->width + 1;
-
-    if (new_map_dim.width > MAX_COORDINATE)
+    if (g->current_map->width + 1 > MAX_COORDINATE)
     {
         (void) printf("Unable to comply: Adding new column would exceed maximum possible map size.\n");
         return;
     }
 
-    Map *new_map = create_map(new_map_dim);
-    if (error_code)
-        return;
+    add_rows_and_columns(g, 0, 0, 0, 1, false);
+    return;
+}
 
-    Room ***new_layout = create_initial_layout(new_map);
+/************************************************************************************************************
+ * add_rows_and_columns:    Purpose: Adds any number of rows/columns to each side of the map at once        *
+ *                                   (callers are responsible for checking against MAX_COORDINATE).         *
+ *                          Parameters: Gamestate *g -> the gamestate containing the map to add to          *
+ *                                      int32_t rows_north/columns_east/rows_south/columns_west             *
+ *                                          -> the amount to add per side                                   *
+ *                                      bool blank -> whether the new rooms start out deleted               *
+ *                          Return value: none                                                              *
+ *                          Side effects: - Edits the map, cursor, marks and display.                       *
+ *                                        - Edits global variable "error_code"                              *
+ ************************************************************************************************************/
+void add_rows_and_columns(Gamestate *g, int32_t rows_north, int32_t columns_east, int32_t rows_south, int32_t columns_west, bool blank)
+{
+    grow_map(g->current_map, rows_north, columns_east, rows_south, columns_west, blank);
     if (error_code)
-    {
-        free_layout(new_layout, new_map_dim.height);
-        free_map(new_map);
         return;
-    }
-
-    // Transfer established Room properties:
-    for (int32_t row = 0; row < g->current_map->height; row++)
-    {
-        for (int32_t column = 0; column < g->current_map->width; column++)
-        {
-            new_layout[row][column + 1]->exists = g->display->layout[row][column]->exists;
-            new_layout[row][column + 1]->mark = g->display->layout[row][column]->mark;
-            for (int cardinal_direction = NORTH; cardinal_direction < NUM_CARDINAL_DIRECTIONS; cardinal_direction++)
-            {
-                new_layout[row][column + 1]->exits[cardinal_direction] = g->display->layout[row][column]->exits[cardinal_direction];
-            }
-        }
-    }
 
-    // Transfer marked rooms:
-    if (g->start)
-        g->start = new_layout[g->start->y_coordinate][g->start->x_coordinate + 1];
-    if (g->end)
-        g->end = new_layout[g->end->y_coordinate][g->end->x_coordinate + 1];
-
-    free_layout(g->display->layout, g->current_map->height);
-    free_map(g->current_map);
-    g->display->layout = new_layout;
-    g->current_map = new_map;
-    g->current_cursor_focus = g->display->layout[cursor_y][cursor_x + 1];
+    // Shift cursor along with its room, but no further than the southern/eastern end of display
+    // (to prevent cursor falling out of display after rows/columns are added):
+    int32_t display_bottom = (g->display->height - 1) + g->display->y_offset;
+    int32_t display_right = (g->display->width - 1) + g->display->x_offset;
+    if (rows_north)
+        g->current_cursor_focus.y_coordinate = g->current_cursor_focus.y_coordinate + rows_north > display_bottom ? display_bottom : g->current_cursor_focus.y_coordinate + rows_north;
+    if (columns_west)
+        g->current_cursor_focus.x_coordinate = g->current_cursor_focus.x_coordinate + columns_west > display_right ? display_right : g->current_cursor_focus.x_coordinate + columns_west;
+    shift_marks(g, rows_north, columns_west);
 
     // Resize display:
-    if (g->display->width < g->current_map->width && g->current_map->width <= g->user_settings->max_display_width)
+    if ((rows_north || rows_south) && g->display->height < g->current_map->height && g->current_map->height <= g->user_settings->max_display_height)
+        g->display->height = g->current_map->height, g->display->y_offset = 0;
+    if ((columns_east || columns_west) && g->display->width < g->current_map->width && g->current_map->width <= g->user_settings->max_display_width)
         g->display->width = g->current_map->width, g->display->x_offset = 0;
 
     return;
@@ -2156,11 +3724,11 @@ void mark(char mark, Gamestate *g)
     {
         default: error_code = 15; break;
         case 'S':
-            if (g->start == g->current_cursor_focus)
+            if (same_room(g->start, g->current_cursor_focus))
             {
                 // Do nothing.
             }
-            else if (g->start != NULL)
+            else if (!same_room(g->start, NO_ROOM))
             {
                 do
                 {
@@ -2169,31 +3737,28 @@ void mark(char mark, Gamestate *g)
                 } while (yesno != 'y' && yesno != 'n');
                 if (yesno == 'y')
                 {
-                    g->start->mark = 0;
                     g->start = g->current_cursor_focus;
-                    g->current_cursor_focus->mark = 'S';
-                    if (g->end == g->start) // If overriding one mark with the other:
+                    if (same_room(g->end, g->start)) // If overriding one mark with the other:
                     {
-                        g->end = NULL;
+                        g->end = NO_ROOM;
                     }
                 }
             }
             else
             {
                 g->start = g->current_cursor_focus;
-                g->current_cursor_focus->mark = 'S';
-                if (g->end == g->start) // If overriding one mark with the other:
+                if (same_room(g->end, g->start)) // If overriding one mark with the other:
                 {
-                    g->end = NULL;
+                    g->end = NO_ROOM;
                 }
             }
             break;
         case 'E':
-            if (g->end == g->current_cursor_focus)
+            if (same_room(g->end, g->current_cursor_focus))
             {
                 // Do nothing.
             }
-            else if (g->end != NULL)
+            else if (!same_room(g->end, NO_ROOM))
             {
                 do
                 {
@@ -2202,38 +3767,29 @@ void mark(char mark, Gamestate *g)
                 } while (yesno != 'y' && yesno != 'n');
                 if (yesno == 'y')
                 {
-                    g->end->mark = 0;
                     g->end = g->current_cursor_focus;
-                    g->current_cursor_focus->mark = 'E';
-                    if (g->start == g->end) // If overriding one mark with the other:
+                    if (same_room(g->start, g->end)) // If overriding one mark with the other:
                     {
-                        g->start = NULL;
+                        g->start = NO_ROOM;
                     }
                 }
             }
             else
             {
                 g->end = g->current_cursor_focus;
-                g->current_cursor_focus->mark = 'E';
-                if (g->start == g->end) // If overriding one mark with the other:
+                if (same_room(g->start, g->end)) // If overriding one mark with the other:
                 {
-                    g->start = NULL;
+                    g->start = NO_ROOM;
                 }
             }
             break;
         case 0:
-            if (g->current_cursor_focus->mark != 0)
+            if (room_mark(g, g->current_cursor_focus) != 0)
             {
-                if (g->current_cursor_focus->mark == 'S')
-                {
-                    g->start = NULL;
-                    g->current_cursor_focus->mark = 0;
-                }
+                if (room_mark(g, g->current_cursor_focus) == 'S')
+                    g->start = NO_ROOM;
                 else
-                {
-                    g->end = NULL;
-                    g->current_cursor_focus->mark = 0;
-                }
+                    g->end = NO_ROOM;
             }
             break;
     }
@@ -2241,37 +3797,29 @@ void mark(char mark, Gamestate *g)
 
 void delete(Gamestate *g)
 {
-    g->current_cursor_focus->exists = false;
+    set_cursor_room_exists(g, false);
     // Remove start/end mark so that it can be placed elsewhere (and so that undeleting later doesn't conflict with new start/end):
     mark(0, g);
     // Remove exits between this and surrounding rooms so the display doesn't end up with a hanging connection to a nonexistent room:
     for (int i = NORTH; i < NUM_CARDINAL_DIRECTIONS; i++)
     {
-        g->current_cursor_focus->exits[i] = false;
+        set_cursor_exit(g, i, false);
     }
-    if (g->current_cursor_focus->y_coordinate != 0)
-        g->display->layout[g->current_cursor_focus->y_coordinate - 1][g->current_cursor_focus->x_coordinate]->exits[SOUTH] = false;
-    if (g->current_cursor_focus->x_coordinate != g->current_map->width - 1)
-        g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate + 1]->exits[WEST] = false;
-    if (g->current_cursor_focus->y_coordinate != g->current_map->height - 1)
-        g->display->layout[g->current_cursor_focus->y_coordinate + 1][g->current_cursor_focus->x_coordinate]->exits[NORTH] = false;
-    if (g->current_cursor_focus->x_coordinate != 0)
-        g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate - 1]->exits[EAST] = false;
 
     return;
 }
 
 void undelete(Gamestate *g)
 {
-    g->current_cursor_focus->exists = true;
+    set_cursor_room_exists(g, true);
     return;
 }
 
-void open(Gamestate *g, int direction)
+void open_exit(Gamestate *g, int direction)
 {
     int yesno = 0;
 
-    if (!g->current_cursor_focus->exists)
+    if (!cursor_room_exists(g))
     {
         #ifdef FORCE_BUFFERED_MODE
             do
@@ -2303,7 +3851,7 @@ void open(Gamestate *g, int direction)
     {
         default: error_code = 16; break;
         case NORTH:
-            if (g->current_cursor_focus->y_coordinate == 0)
+            if (g->current_cursor_focus.y_coordinate == 0)
             {
                 #ifdef FORCE_BUFFERED_MODE
                     do
@@ -2324,7 +3872,7 @@ void open(Gamestate *g, int direction)
                     add_row_north(g);
                 }
             }
-            else if (!g->display->layout[g->current_cursor_focus->y_coordinate - 1][g->current_cursor_focus->x_coordinate]->exists)
+            else if (!room_exists(g->current_map, g->current_cursor_focus.y_coordinate - 1, g->current_cursor_focus.x_coordinate))
             {
                 #ifdef FORCE_BUFFERED_MODE
                     do
@@ -2342,19 +3890,18 @@ void open(Gamestate *g, int direction)
 
                 if (yesno == 'y')
                 {
-                    g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate - 1][g->current_cursor_focus->x_coordinate];
+                    g->current_cursor_focus.y_coordinate--;
                     undelete(g);
-                    g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate + 1][g->current_cursor_focus->x_coordinate];
+                    g->current_cursor_focus.y_coordinate++;
                 }
             }
             if (yesno == 'y' || yesno == 0)
             {
-                g->current_cursor_focus->exits[NORTH] = true;
-                g->display->layout[g->current_cursor_focus->y_coordinate - 1][g->current_cursor_focus->x_coordinate]->exits[SOUTH] = true;
+                set_cursor_exit(g, NORTH, true);
             }
             break;
         case EAST:
-            if (g->current_cursor_focus->x_coordinate == g->current_map->width - 1)
+            if (g->current_cursor_focus.x_coordinate == g->current_map->width - 1)
             {
                 #ifdef FORCE_BUFFERED_MODE
                     do
@@ -2375,7 +3922,7 @@ void open(Gamestate *g, int direction)
                     add_column_east(g);
                 }
             }
-            else if (!g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate + 1]->exists)
+            else if (!room_exists(g->current_map, g->current_cursor_focus.y_coordinate, g->current_cursor_focus.x_coordinate + 1))
             {
                 #ifdef FORCE_BUFFERED_MODE
                     do
@@ -2393,19 +3940,18 @@ void open(Gamestate *g, int direction)
 
                 if (yesno == 'y')
                 {
-                    g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate + 1];
+                    g->current_cursor_focus.x_coordinate++;
                     undelete(g);
-                    g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate - 1];
+                    g->current_cursor_focus.x_coordinate--;
                 }
             }
             if (yesno == 'y' || yesno == 0)
             {
-                g->current_cursor_focus->exits[EAST] = true;
-                g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate + 1]->exits[WEST] = true;
+                set_cursor_exit(g, EAST, true);
             }
             break;
         case SOUTH:
-            if (g->current_cursor_focus->y_coordinate == g->current_map->height - 1)
+            if (g->current_cursor_focus.y_coordinate == g->current_map->height - 1)
             {
                 #ifdef FORCE_BUFFERED_MODE
                     do
@@ -2426,7 +3972,7 @@ void open(Gamestate *g, int direction)
                     add_row_south(g);
                 }
             }
-            else if (!g->display->layout[g->current_cursor_focus->y_coordinate + 1][g->current_cursor_focus->x_coordinate]->exists)
+            else if (!room_exists(g->current_map, g->current_cursor_focus.y_coordinate + 1, g->current_cursor_focus.x_coordinate))
             {
                 #ifdef FORCE_BUFFERED_MODE
                     do
@@ -2444,19 +3990,18 @@ void open(Gamestate *g, int direction)
 
                 if (yesno == 'y')
                 {
-                    g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate + 1][g->current_cursor_focus->x_coordinate];
+                    g->current_cursor_focus.y_coordinate++;
                     undelete(g);
-                    g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate - 1][g->current_cursor_focus->x_coordinate];
+                    g->current_cursor_focus.y_coordinate--;
                 }
             }
             if (yesno == 'y' || yesno == 0)
             {
-                g->current_cursor_focus->exits[SOUTH] = true;
-                g->display->layout[g->current_cursor_focus->y_coordinate + 1][g->current_cursor_focus->x_coordinate]->exits[NORTH] = true;
+                set_cursor_exit(g, SOUTH, true);
             }
             break;
         case WEST:
-            if (g->current_cursor_focus->x_coordinate == 0)
+            if (g->current_cursor_focus.x_coordinate == 0)
             {
                 #ifdef FORCE_BUFFERED_MODE
                     do
@@ -2477,7 +4022,7 @@ void open(Gamestate *g, int direction)
                     add_column_west(g);
                 }
             }
-            else if (!g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate - 1]->exists)
+            else if (!room_exists(g->current_map, g->current_cursor_focus.y_coordinate, g->current_cursor_focus.x_coordinate - 1))
             {
                 #ifdef FORCE_BUFFERED_MODE
                     do
@@ -2495,54 +4040,49 @@ void open(Gamestate *g, int direction)
 
                 if (yesno == 'y')
                 {
-                    g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate - 1];
+                    g->current_cursor_focus.x_coordinate--;
                     undelete(g);
-                    g->current_cursor_focus = g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate + 1];
+                    g->current_cursor_focus.x_coordinate++;
                 }
             }
             if (yesno == 'y' || yesno == 0)
             {
-                g->current_cursor_focus->exits[WEST] = true;
-                g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate - 1]->exits[EAST] = true;
+                set_cursor_exit(g, WEST, true);
             }
             break;
     }
     return;
 }
 
-void close(Gamestate *g, int direction)
+void close_exit(Gamestate *g, int direction)
 {
-    if (g->current_cursor_focus->exists)
+    if (cursor_room_exists(g))
     {
         switch (direction)
         {
             default: error_code = 17; break;
             case NORTH:
-                if (g->current_cursor_focus->y_coordinate != 0 && g->current_cursor_focus->exits[NORTH])
+                if (g->current_cursor_focus.y_coordinate != 0 && cursor_exit(g, NORTH))
                 {
-                    g->current_cursor_focus->exits[NORTH] = false;
-                    g->display->layout[g->current_cursor_focus->y_coordinate - 1][g->current_cursor_focus->x_coordinate]->exits[SOUTH] = false;
+                    set_cursor_exit(g, NORTH, false);
                 }
                 break;
             case EAST:
-                if (g->current_cursor_focus->x_coordinate != g->current_map->width - 1 && g->current_cursor_focus->exits[EAST])
+                if (g->current_cursor_focus.x_coordinate != g->current_map->width - 1 && cursor_exit(g, EAST))
                 {
-                    g->current_cursor_focus->exits[EAST] = false;
-                    g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate + 1]->exits[WEST] = false;
+                    set_cursor_exit(g, EAST, false);
                 }
                 break;
             case SOUTH:
-                if (g->current_cursor_focus->y_coordinate != g->current_map->height - 1 && g->current_cursor_focus->exits[SOUTH])
+                if (g->current_cursor_focus.y_coordinate != g->current_map->height - 1 && cursor_exit(g, SOUTH))
                 {
-                    g->current_cursor_focus->exits[SOUTH] = false;
-                    g->display->layout[g->current_cursor_focus->y_coordinate + 1][g->current_cursor_focus->x_coordinate]->exits[NORTH] = false;
+                    set_cursor_exit(g, SOUTH, false);
                 }
                 break;
             case WEST:
-                if (g->current_cursor_focus->x_coordinate != 0 && g->current_cursor_focus->exits[WEST])
+                if (g->current_cursor_focus.x_coordinate != 0 && cursor_exit(g, WEST))
                 {
-                    g->current_cursor_focus->exits[WEST] = false;
-                    g->display->layout[g->current_cursor_focus->y_coordinate][g->current_cursor_focus->x_coordinate - 1]->exits[EAST] = false;
+                    set_cursor_exit(g, WEST, false);
                 }
                 break;
         }
@@ -2552,63 +4092,20 @@ void close(Gamestate *g, int direction)
 
 void remove_row_north(Gamestate *g)
 {
-    // Store cursor position, adjusting inward if on row/column to delete:
-    int32_t cursor_y = g->current_cursor_focus->y_coordinate == 0 ? g->current_cursor_focus->y_coordinate + 1 : g->current_cursor_focus->y_coordinate;
-    int32_t cursor_x = g->current_cursor_focus->x_coordinate;
-
-    Dimensions new_map_dim;
-    new_map_dim.height = g->current_map->height - 1;
-    new_map_dim.width = g->current_map->width;
-
-    if (new_map_dim.height < 1)
+    if (g->current_map->height - 1 < 1)
     {
         (void) printf("Unable to comply: Map must have a minimum height of 1.\n");
         return;
     }
 
-    Map *new_map = create_map(new_map_dim);
-    if (error_code)
-        return;
-
-    Room ***new_layout = create_initial_layout(new_map);
-    if (error_code)
-    {
-        free_layout(new_layout, new_map_dim.height);
-        free_map(new_map);
-        return;
-    }
-
-    for (int32_t column = 0; column < g->current_map->width; column++)
-    {
-        g->current_cursor_focus = g->display->layout[0][column];
-        delete(g);
-    }
-
-    // Transfer established Room properties:
-    for (int32_t row = 0; row < g->current_map->height - 1; row++)
-    {
-        for (int32_t column = 0; column < g->current_map->width; column++)
-        {
-            new_layout[row][column]->exists = g->display->layout[row + 1][column]->exists;
-            new_layout[row][column]->mark = g->display->layout[row + 1][column]->mark;
-            for (int cardinal_direction = NORTH; cardinal_direction < NUM_CARDINAL_DIRECTIONS; cardinal_direction++)
-            {
-                new_layout[row][column]->exits[cardinal_direction] = g->display->layout[row + 1][column]->exits[cardinal_direction];
-            }
-        }
-    }
-
-    // Transfer marked rooms:
-    if (g->start)
-        g->start = new_layout[g->start->y_coordinate - 1][g->start->x_coordinate];
-    if (g->end)
-        g->end = new_layout[g->end->y_coordinate - 1][g->end->x_coordinate];
+    shrink_map(g->current_map, 1, 0, 0, 0);
 
-    free_layout(g->display->layout, g->current_map->height);
-    free_map(g->current_map);
-    g->display->layout = new_layout;
-    g->current_map = new_map;
-    g->current_cursor_focus = g->display->layout[cursor_y - 1][cursor_x];
+    // Shift cursor along with its room, adjusting inward if on removed row:
+    if (g->current_cursor_focus.y_coordinate > 0)
+        g->current_cursor_focus.y_coordinate--;
+    // Transfer marked rooms, dropping any mark that was on the removed row:
+    shift_marks(g, -1, 0);
+    unmark_outside_map(g);
 
     // Shrink offset:
     if (g->display->y_offset > 0)
@@ -2623,63 +4120,20 @@ void remove_row_north(Gamestate *g)
 
 void remove_column_east(Gamestate *g)
 {
-    // Store cursor position, adjusting inward if on row/column to delete:
-    int32_t cursor_y = g->current_cursor_focus->y_coordinate;
-    int32_t cursor_x = g->current_cursor_focus->x_coordinate == (g->display->width - 1) + g->display->x_offset ? g->current_cursor_focus->x_coordinate - 1 : g->current_cursor_focus->x_coordinate;
-
-    Dimensions new_map_dim;
-    new_map_dim.height = g->current_map->height;
-    new_map_dim.width = g->current_map->width - 1;
-
-    if (new_map_dim.width < 1)
+    if (g->current_map->width - 1 < 1)
     {
         (void) printf("Unable to comply: Map must have a minimum width of 1.\n");
         return;
     }
 
-    Map *new_map = create_map(new_map_dim);
-    if (error_code)
-        return;
-
-    Room ***new_layout = create_initial_layout(new_map);
-    if (error_code)
-    {
-        free_layout(new_layout, new_map_dim.height);
-        free_map(new_map);
-        return;
-    }
-
-    for (int32_t row = 0; row < g->current_map->height; row++)
-    {
-        g->current_cursor_focus = g->display->layout[row][g->current_map->width - 1];
-        delete(g);
-    }
-
-    // Transfer established Room properties:
-    for (int32_t row = 0; row < g->current_map->height; row++)
-    {
-        for (int32_t column = 0; column < g->current_map->width - 1; column++)
-        {
-            new_layout[row][column]->exists = g->display->layout[row][column]->exists;
-            new_layout[row][column]->mark = g->display->layout[row][column]->mark;
-            for (int cardinal_direction = NORTH; cardinal_direction < NUM_CARDINAL_DIRECTIONS; cardinal_direction++)
-            {
-                new_layout[row][column]->exits[cardinal_direction] = g->display->layout[row][column]->exits[cardinal_direction];
-            }
-        }
-    }
+    // Adjust cursor inward if on eastern end of display:
+    if (g->current_cursor_focus.x_coordinate == (g->display->width - 1) + g->display->x_offset)
+        g->current_cursor_focus.x_coordinate--;
 
-    // Transfer marked rooms:
-    if (g->start)
-        g->start = new_layout[g->start->y_coordinate][g->start->x_coordinate];
-    if (g->end)
-        g->end = new_layout[g->end->y_coordinate][g->end->x_coordinate];
+    shrink_map(g->current_map, 0, 1, 0, 0);
 
-    free_layout(g->display->layout, g->current_map->height);
-    free_map(g->current_map);
-    g->display->layout = new_layout;
-    g->current_map = new_map;
-    g->current_cursor_focus = g->display->layout[cursor_y][cursor_x];
+    // Drop any mark that was on the removed column:
+    unmark_outside_map(g);
 
     // Shrink offset:
     if (g->display->x_offset > 0)
@@ -2687,70 +4141,27 @@ void remove_column_east(Gamestate *g)
 
     // Resize display:
     if (g->display->width > g->current_map->width)
-        g->display->width = g->current_map->width, g->display->x_offset = 0;
-
-    return;
-}
-
-void remove_row_south(Gamestate *g)
-{
-    // Store cursor position, adjusting inward if on row/column to delete:
-    int32_t cursor_y = g->current_cursor_focus->y_coordinate == (g->display->height - 1) + g->display->y_offset ? g->current_cursor_focus->y_coordinate - 1 : g->current_cursor_focus->y_coordinate;
-    int32_t cursor_x = g->current_cursor_focus->x_coordinate;
-
-    Dimensions new_map_dim;
-    new_map_dim.height = g->current_map->height - 1;
-    new_map_dim.width = g->current_map->width;
-
-    if (new_map_dim.height < 1)
-    {
-        (void) printf("Unable to comply: Map must have a minimum height of 1.\n");
-        return;
-    }
+        g->display->width = g->current_map->width, g->display->x_offset = 0;
 
-    Map *new_map = create_map(new_map_dim);
-    if (error_code)
-        return;
+    return;
+}
 
-    Room ***new_layout = create_initial_layout(new_map);
-    if (error_code)
+void remove_row_south(Gamestate *g)
+{
+    if (g->current_map->height - 1 < 1)
     {
-        free_layout(new_layout, new_map_dim.height);
-        free_map(new_map);
+        (void) printf("Unable to comply: Map must have a minimum height of 1.\n");
         return;
     }
 
-    for (int32_t column = 0; column < g->current_map->width; column++)
-    {
-        g->current_cursor_focus = g->display->layout[g->current_map->height - 1][column];
-        delete(g);
-    }
-
-    // Transfer established Room properties:
-    for (int32_t row = 0; row < g->current_map->height - 1; row++)
-    {
-        for (int32_t column = 0; column < g->current_map->width; column++)
-        {
-            new_layout[row][column]->exists = g->display->layout[row][column]->exists;
-            new_layout[row][column]->mark = g->display->layout[row][column]->mark;
-            for (int cardinal_direction = NORTH; cardinal_direction < NUM_CARDINAL_DIRECTIONS; cardinal_direction++)
-            {
-                new_layout[row][column]->exits[cardinal_direction] = g->display->layout[row][column]->exits[cardinal_direction];
-            }
-        }
-    }
+    // Adjust cursor inward if on southern end of display:
+    if (g->current_cursor_focus.y_coordinate == (g->display->height - 1) + g->display->y_offset)
+        g->current_cursor_focus.y_coordinate--;
 
-    // Transfer marked rooms:
-    if (g->start)
-        g->start = new_layout[g->start->y_coordinate][g->start->x_coordinate];
-    if (g->end)
-        g->end = new_layout[g->end->y_coordinate][g->end->x_coordinate];
+    shrink_map(g->current_map, 0, 0, 1, 0);
 
-    free_layout(g->display->layout, g->current_map->height);
-    free_map(g->current_map);
-    g->display->layout = new_layout;
-    g->current_map = new_map;
-    g->current_cursor_focus = g->display->layout[cursor_y][cursor_x];
+    // Drop any mark that was on the removed row:
+    unmark_outside_map(g);
 
     // Shrink offset:
     if (g->display->y_offset > 0)
@@ -2765,63 +4176,20 @@ void remove_row_south(Gamestate *g)
 
 void remove_column_west(Gamestate *g)
 {
-    // Store cursor position, adjusting inward if on row/column to delete:
-    int32_t cursor_y = g->current_cursor_focus->y_coordinate;
-    int32_t cursor_x = g->current_cursor_focus->x_coordinate ==  0 ? g->current_cursor_focus->x_coordinate + 1 : g->current_cursor_focus->x_coordinate;
-
-    Dimensions new_map_dim;
-    new_map_dim.height = g->current_map->height;
-    new_map_dim.width = g->current_map->width - 1;
-
-    if (new_map_dim.width < 1)
+    if (g->current_map->width - 1 < 1)
     {
         (void) printf("Unable to comply: Map must have a minimum width of 1.\n");
         return;
     }
 
-    Map *new_map = create_map(new_map_dim);
-    if (error_code)
-        return;
-
-    Room ***new_layout = create_initial_layout(new_map);
-    if (error_code)
-    {
-        free_layout(new_layout, new_map_dim.height);
-        free_map(new_map);
-        return;
-    }
-
-    for (int32_t row = 0; row < g->current_map->height; row++)
-    {
-        g->current_cursor_focus = g->display->layout[row][0];
-        delete(g);
-    }
-
-    // Transfer established Room properties:
-    for (int32_t row = 0; row < g->current_map->height; row++)
-    {
-        for (int32_t column = 0; column < g->current_map->width - 1; column++)
-        {
-            new_layout[row][column]->exists = g->display->layout[row][column + 1]->exists;
-            new_layout[row][column]->mark = g->display->layout[row][column + 1]->mark;
-            for (int cardinal_direction = NORTH; cardinal_direction < NUM_CARDINAL_DIRECTIONS; cardinal_direction++)
-            {
-                new_layout[row][column]->exits[cardinal_direction] = g->display->layout[row][column + 1]->exits[cardinal_direction];
-            }
-        }
-    }
-
-    // Transfer marked rooms:
-    if (g->start)
-        g->start = new_layout[g->start->y_coordinate][g->start->x_coordinate - 1];
-    if (g->end)
-        g->end = new_layout[g->end->y_coordinate][g->end->x_coordinate - 1];
+    shrink_map(g->current_map, 0, 0, 0, 1);
 
-    free_layout(g->display->layout, g->current_map->height);
-    free_map(g->current_map);
-    g->display->layout = new_layout;
-    g->current_map = new_map;
-    g->current_cursor_focus = g->display->layout[cursor_y][cursor_x - 1];
+    // Shift cursor along with its room, adjusting inward if on removed column:
+    if (g->current_cursor_focus.x_coordinate > 0)
+        g->current_cursor_focus.x_coordinate--;
+    // Transfer marked rooms, dropping any mark that was on the removed column:
+    shift_marks(g, 0, -1);
+    unmark_outside_map(g);
 
     // Shrink offset:
     if (g->display->x_offset > 0)
@@ -2872,11 +4240,17 @@ void save_gamestate(Gamestate *savable_gamestate)
         // Loop prompts for and stores valid filename to be used for the savefile:
         do
         {
+            free(savable_gamestate->current_filename);
+            savable_gamestate->current_filename = NULL;
             return_code = get_command("Save under what filename?\n> ", savable_gamestate, 's');
             if (return_code == -1)
                 return;
-            // Test whether a file with this name already exists:
-            savefile = fopen(strcat(savable_gamestate->current_filename, ".ifmap"), "r");
+            // Test whether a file with this name already exists (the filename itself is kept without its extension):
+            char *path = savefile_path(savable_gamestate->current_filename, SAVEFILE_EXTENSION, false);
+            if (path == NULL)
+                return;
+            savefile = fopen(path, "r");
+            free(path);
             if (savefile == NULL)
                 valid = true;
             else // If a file with this name already exists, confirm whether to save over it:
@@ -2900,150 +4274,765 @@ void save_gamestate(Gamestate *savable_gamestate)
         return;
     }
 
-    savefile = fopen(strcat(savable_gamestate->current_filename, ".ifmap"), "w");
+    // Compression makes big maps far smaller, at some cost in speed:
+    (void) printf("Compress the map? (y/n)\n");
+    do
+    {
+        y_n = tolower(getchar()); while (getchar() != '\n');
+    } while (y_n != 'y' && y_n != 'n');
+
+    // Write everything to a temporary file first and only then rename it over the savefile,
+    // so that a failed or interrupted save never leaves a half-written map in its place:
+    char *path = savefile_path(savable_gamestate->current_filename, SAVEFILE_EXTENSION, false);
+    char *temporary_path = savefile_path(savable_gamestate->current_filename, SAVEFILE_EXTENSION, true);
+    if (path == NULL || temporary_path == NULL)
+    {
+        free(path), free(temporary_path);
+        return;
+    }
+    uint32_t header_crc = 0;
+    uint64_t length = 0;
+    error_code = write_savefile(savable_gamestate, path, temporary_path, y_n == 'y', &header_crc, &length);
+    if (error_code && error_code != 33)
+        (void) remove(temporary_path);
+    free(path), free(temporary_path);
+    if (error_code)
+        return;
+    savable_gamestate->saved = true;
+
+    // The savefile now holds every edit, so the journal starts over from it
+    // (as does any journal left under the new name by an earlier session):
+    discard_journal(&savable_gamestate->journal);
+    char *journal_path = savefile_path(savable_gamestate->current_filename, JOURNAL_EXTENSION, false);
+    if (journal_path != NULL)
+        (void) remove(journal_path);
+    free(journal_path);
+    rebase_journal(savable_gamestate, true, header_crc, length);
+    return;
+}
+
+/*********************************************************************************************
+ * write_savefile:    Purpose: Writes the gamestate to a temporary file as a v2 savefile,    *
+ *                             makes sure it has reached the disk, then renames it over the  *
+ *                             file at path (the temporary file is left behind on failure).  *
+ *                    Parameters: Gamestate *g -> the gamestate to be saved                  *
+ *                                const char *path, *temporary_path -> the files to write    *
+ *                                bool compress -> whether to compress the map's planes      *
+ *                                uint32_t *header_crc -> receives the CRC-32 of the header  *
+ *                                uint64_t *length -> receives the length of the file        *
+ *                    Return value: int -> 0 on success, else the error code for what failed *
+ *                    Side effects: - Creates/replaces external files.                       *
+ *                                  - Allocates and frees memory.                            *
+ *********************************************************************************************/
+int write_savefile(Gamestate *g, const char *path, const char *temporary_path, bool compress, uint32_t *header_crc, uint64_t *length)
+{
+    Save_Buffer buffer = {0};
+    buffer.bytes = malloc(SAVE_BUFFER_SIZE);
+    if (buffer.bytes == NULL)
+        return 32;
+    buffer.file = fopen(temporary_path, "wb");
+    if (buffer.file == NULL)
+        return free(buffer.bytes), 27;
+
+    *header_crc = encode_savefile(g, &buffer, compress);
+    *length = buffer.offset;
+    flush_save_buffer(&buffer);
+    if (!buffer.failed && fflush(buffer.file) == EOF)
+        buffer.failed = true;
+    #ifdef POSIX_FILE_IO
+        // Make sure the data has reached the disk before the rename can:
+        if (!buffer.failed && fsync(fileno(buffer.file)) == -1)
+            buffer.failed = true;
+    #endif
+    int fclose_return = fclose(buffer.file);
+    free(buffer.bytes);
+    if (buffer.failed || fclose_return == EOF)
+        return !buffer.failed ? 28 : fclose_return == EOF ? 29 : 27;
+
+    #ifndef POSIX_FILE_IO
+        (void) remove(path); // (Elsewhere, rename() may refuse to replace an existing file.)
+    #endif
+    if (rename(temporary_path, path) != 0)
+        return 33;
+    return 0;
+}
+
+/*********************************************************************************************
+ * encode_savefile:    Purpose: Serializes the gamestate into the save buffer as a v2        *
+ *                              savefile (see decode_savefile_v2): a placeholder header,     *
+ *                              then each section in turn, then the real header, written     *
+ *                              over the placeholder once the sections' CRCs are known.      *
+ *                     Parameters: Gamestate *g -> the gamestate to be saved                 *
+ *                                 Save_Buffer *b -> the buffer to serialize into            *
+ *                                 bool compress -> whether to compress the map's planes     *
+ *                     Return value: uint32_t -> the CRC-32 of the header (which, holding    *
+ *                                   every section's CRC, identifies the file's contents)    *
+ *                     Side effects: - Writes to the savefile (whenever the buffer fills).   *
+ *********************************************************************************************/
+uint32_t encode_savefile(Gamestate *g, Save_Buffer *b, bool compress)
+{
+    unsigned char header[SAVEFILE_HEADER_SIZE] = {0};
+    buffer_bytes(b, header, sizeof(header));
 
-    int fwrite_return = 0;
+    const int sections[NUM_SAVED_SECTIONS] = {compress ? PACKED_MAP_SECTION : MAP_SECTION, MARKS_SECTION, DISPLAY_SECTION, SETTINGS_SECTION, CURSOR_SECTION};
+    for (int i = 0; i < NUM_SAVED_SECTIONS; i++)
+    {
+        int type = sections[i];
+        uint64_t offset = b->offset;
+        b->crc = 0;
+        switch (type)
+        {
+            case MAP_SECTION: encode_map_section(g->current_map, b); break;
+            case PACKED_MAP_SECTION: encode_packed_map_section(g->current_map, b); break;
+            case MARKS_SECTION:
+                buffer_int32(b, g->start.y_coordinate), buffer_int32(b, g->start.x_coordinate);
+                buffer_int32(b, g->end.y_coordinate), buffer_int32(b, g->end.x_coordinate);
+                break;
+            case DISPLAY_SECTION:
+                buffer_int32(b, g->display->height), buffer_int32(b, g->display->width);
+                buffer_int32(b, g->display->y_offset), buffer_int32(b, g->display->x_offset);
+                break;
+            case SETTINGS_SECTION:
+            {
+                unsigned char movement_mode = g->user_settings->movement_mode == NESW ? 0 : 1;
+                buffer_bytes(b, &movement_mode, 1);
+                buffer_int32(b, g->user_settings->max_display_height), buffer_int32(b, g->user_settings->max_display_width);
+                break;
+            }
+            case CURSOR_SECTION:
+                buffer_int32(b, g->current_cursor_focus.y_coordinate), buffer_int32(b, g->current_cursor_focus.x_coordinate);
+                break;
+        }
 
-    // From here to end: Encode data and write.
+        unsigned char *entry = header + SAVEFILE_PREAMBLE_SIZE + i * SAVEFILE_SECTION_ENTRY_SIZE;
+        write_le32(entry, (uint32_t) type);
+        write_le32(entry + 4, b->crc);
+        write_le64(entry + 8, offset);
+        write_le64(entry + 16, b->offset - offset);
+    }
+    (void) memcpy(header, SAVEFILE_MAGIC, strlen(SAVEFILE_MAGIC));
+    write_le16(header + 4, SAVEFILE_VERSION);
+    write_le16(header + 6, NUM_SAVED_SECTIONS);
+
+    flush_save_buffer(b);
+    if (!b->failed && (fseek(b->file, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), b->file) != sizeof(header)))
+        b->failed = true;
+    return crc32_update(0, header, sizeof(header));
+}
 
-    // map height = int32_t
-    // map width = int32_t
-    // number of rooms (map height * map width) = int32_t
-    int32_t buffer32n1[3] = {0};
-    buffer32n1[0] = savable_gamestate->current_map->height;
-    buffer32n1[1] = savable_gamestate->current_map->width;
-    buffer32n1[2] = savable_gamestate->current_map->height * savable_gamestate->current_map->width; // Won't exceed int32 size due to MAX_COORDINATE.
+/*********************************************************************************************
+ * encode_map_section:    Purpose: Serializes the map's size and its exists, south and east  *
+ *                                 planes (one bit per room, row-major), copying a tile row  *
+ *                                 (up to 64 rooms) at a time. Passages off the map, which   *
+ *                                 a shrink may have left behind in the tiles, are omitted.  *
+ *                        Parameters: Map *m -> the map to be saved                          *
+ *                                    Save_Buffer *b -> the buffer to serialize into         *
+ *                        Return value: none                                                 *
+ *                        Side effects: - Writes to the savefile (whenever the buffer fills).*
+ *********************************************************************************************/
+void encode_map_section(Map *m, Save_Buffer *b)
+{
+    buffer_int32(b, m->height);
+    buffer_int32(b, m->width);
 
-    for (int i = 0; i < 3; i++)
+    const int planes[3] = {TILE_PLANE_EXISTS, TILE_PLANE_SOUTH, TILE_PLANE_EAST};
+    for (int p = 0; p < 3; p++)
     {
-        fwrite_return = fwrite(buffer32n1[i], sizeof(int32_t), 1, savefile);
-        if (fwrite_return != 1)
+        for (int32_t y = 0; y < m->height && !b->failed; y++)
         {
-            error_code = 27;
-            fclose_return = fclose(savefile);
-            if (fclose_return == EOF)
-                error_code = 29;
-            return;
+            for (int32_t x = 0; x < m->width;)
+            {
+                int first_column;
+                int64_t tile_x = tile_coordinate(m->x_origin + x, &first_column);
+                int columns = m->width - x < TILE_SIZE - first_column ? (int) (m->width - x) : TILE_SIZE - first_column;
+
+                uint64_t bits = plane_row(m, m->y_origin + y, tile_x, planes[p]) >> first_column;
+                if (columns < TILE_SIZE)
+                    bits &= ((uint64_t) 1 << columns) - 1;
+                if (planes[p] == TILE_PLANE_SOUTH && y == m->height - 1)
+                    bits = 0;
+                if (planes[p] == TILE_PLANE_EAST && x + columns == m->width)
+                    bits &= ~((uint64_t) 1 << (columns - 1));
+                buffer_bits(b, bits, columns);
+                x += columns;
+            }
         }
+        end_buffered_bits(b);
     }
+    return;
+}
+
+/*********************************************************************************************
+ * plane_row:    Purpose: Reads one row of one plane of a tile (no bits if it isn't          *
+ *                        allocated).                                                        *
+ *               Parameters: Map *m -> the map containing the tile                           *
+ *                           int64_t world_y -> the world row to read                        *
+ *                           int64_t tile_x -> the tile column to read                       *
+ *                           int plane -> one of TILE_PLANE_EXISTS/SOUTH/EAST                *
+ *               Return value: uint64_t -> the row's bits                                    *
+ *               Side effects: none                                                          *
+ *********************************************************************************************/
+uint64_t plane_row(Map *m, int64_t world_y, int64_t tile_x, int plane)
+{
+    int row;
+    int64_t tile_y = tile_coordinate(world_y, &row);
+    Tile *t = find_tile(m, tile_y, tile_x);
+    if (t == NULL)
+        return 0;
+    return plane == TILE_PLANE_EXISTS ? t->exists[row] : plane == TILE_PLANE_SOUTH ? t->south_edges[row] : t->east_edges[row];
+}
+
+/*********************************************************************************************
+ * flush_save_buffer, buffer_bytes, buffer_int32, buffer_bits, end_buffered_bits:            *
+ *               Purpose: Collect the savefile in large blocks, so that saving costs one     *
+ *                        fwrite() per SAVE_BUFFER_SIZE bytes rather than one per field,     *
+ *                        while keeping count of the bytes buffered and a CRC-32 of them.    *
+ *                        buffer_int32 appends a little-endian int32_t; buffer_bits packs    *
+ *                        bits (the first in bit 0 of each byte), and end_buffered_bits      *
+ *                        pads them out to a whole byte.                                     *
+ *               Parameters: Save_Buffer *b -> the buffer                                    *
+ *                           bytes, count / value / bits, count -> what to append            *
+ *                           (count is at most SAVE_BUFFER_SIZE bytes, or 64 bits)           *
+ *               Return value: none                                                          *
+ *               Side effects: - Writes to the savefile (setting b->failed if it can't).     *
+ *********************************************************************************************/
+void flush_save_buffer(Save_Buffer *b)
+{
+    if (!b->failed && b->used > 0 && fwrite(b->bytes, 1, b->used, b->file) != b->used)
+        b->failed = true;
+    b->used = 0;
+    return;
+}
 
-    // loop:
-    //      room y_coordinate = int32_t
-    //      room x_coordinate = int32_t
-    //      room exists = uint8_t
-    //      room exit north = uint8_t
-    //      room exit east = uint8_t
-    //      room exit south = uint8_t
-    //      room exit west = uint8_t
-    //      room mark (0 for nothing, 1 for start, 2 for end) = uint8_t
+void buffer_bytes(Save_Buffer *b, const unsigned char *bytes, size_t count)
+{
+    if (b->used + count > SAVE_BUFFER_SIZE)
+        flush_save_buffer(b);
+    (void) memcpy(b->bytes + b->used, bytes, count);
+    b->crc = crc32_update(b->crc, bytes, count);
+    b->used += count, b->offset += count;
+    return;
+}
 
-    int32_t buffer32n2[2] = {0};
-    uint8_t buffer8n1[6] = {0};
-    Room *current_room = savable_gamestate->current_map->root;
+void buffer_int32(Save_Buffer *b, int32_t value)
+{
+    unsigned char bytes[4];
+    write_le32(bytes, (uint32_t) value);
+    buffer_bytes(b, bytes, sizeof(bytes));
+    return;
+}
 
-    while (current_room != NULL)
+void buffer_bits(Save_Buffer *b, uint64_t bits, int count)
+{
+    b->pending_bits |= bits << b->pending_count;
+    if (b->pending_count + count < 64)
     {
-        buffer32n2[0] = current_room->y_coordinate;
-        buffer32n2[1] = current_room->x_coordinate;
+        b->pending_count += count;
+        return;
+    }
 
-        buffer8n1[0] = current_room->exists ? 1 : 0;
-        buffer8n1[1] = current_room->exits[NORTH] ? 1 : 0;
-        buffer8n1[2] = current_room->exits[EAST] ? 1 : 0;
-        buffer8n1[3] = current_room->exits[SOUTH] ? 1 : 0;
-        buffer8n1[4] = current_room->exits[WEST] ? 1 : 0;
-        buffer8n1[5] = current_room->mark == 0 ? 0 : current_room->mark == 'S' ? 1 : 2;
-    
-        for (int i = 0; i < 2; i++)
+    unsigned char bytes[8];
+    write_le64(bytes, b->pending_bits);
+    buffer_bytes(b, bytes, sizeof(bytes));
+    int bits_used = 64 - b->pending_count;
+    b->pending_bits = bits_used == 64 ? 0 : bits >> bits_used;
+    b->pending_count = count - bits_used;
+    return;
+}
+
+void end_buffered_bits(Save_Buffer *b)
+{
+    unsigned char bytes[8];
+    write_le64(bytes, b->pending_bits);
+    buffer_bytes(b, bytes, (size_t) (b->pending_count + 7) / 8);
+    b->pending_bits = 0, b->pending_count = 0;
+    return;
+}
+
+/*********************************************************************************************
+ * encode_packed_map_section:    Purpose: Serializes the map's size and planes as for        *
+ *                                        encode_map_section, but compressed: each plane is  *
+ *                                        turned into runs of equal bits (the first bit,     *
+ *                                        then alternating run lengths), and the runs are    *
+ *                                        range coded with adaptive models.                  *
+ *                               Parameters: Map *m -> the map to be saved                   *
+ *                                           Save_Buffer *b -> the buffer to serialize into  *
+ *                               Return value: none                                          *
+ *                               Side effects: - Writes to the savefile (whenever the buffer *
+ *                                               fills).                                     *
+ *********************************************************************************************/
+void encode_packed_map_section(Map *m, Save_Buffer *b)
+{
+    buffer_int32(b, m->height);
+    buffer_int32(b, m->width);
+
+    Run_Models models;
+    initialize_run_models(&models);
+    Range_Encoder e = {b, 0, 0xFFFFFFFFu, 0, 1};
+
+    const int planes[3] = {TILE_PLANE_EXISTS, TILE_PLANE_SOUTH, TILE_PLANE_EAST};
+    for (int p = 0; p < 3; p++)
+    {
+        int value = -1; // (The value of the current run; none yet.)
+        uint64_t run = 0;
+        for (int32_t y = 0; y < m->height && !b->failed; y++)
         {
-            fwrite_return = fwrite(buffer32n2[i], sizeof(int32_t), 1, savefile);
-            if (fwrite_return != 1)
+            for (int32_t x = 0; x < m->width;)
             {
-                error_code = 27;
-                fclose_return = fclose(savefile);
-                if (fclose_return == EOF)
-                    error_code = 29;
-                return;
+                // The same bits encode_map_section() would write:
+                int first_column;
+                int64_t tile_x = tile_coordinate(m->x_origin + x, &first_column);
+                int columns = m->width - x < TILE_SIZE - first_column ? (int) (m->width - x) : TILE_SIZE - first_column;
+                uint64_t bits = plane_row(m, m->y_origin + y, tile_x, planes[p]) >> first_column;
+                if (columns < TILE_SIZE)
+                    bits &= ((uint64_t) 1 << columns) - 1;
+                if (planes[p] == TILE_PLANE_SOUTH && y == m->height - 1)
+                    bits = 0;
+                if (planes[p] == TILE_PLANE_EAST && x + columns == m->width)
+                    bits &= ~((uint64_t) 1 << (columns - 1));
+                x += columns;
+
+                if (value == -1)
+                {
+                    value = (int) (bits & 1);
+                    encode_bit(&e, &models.first_bit[p], value);
+                }
+                // Extend the current run up to the next bit that differs from it, a whole word at a time:
+                for (int remaining = columns; remaining > 0;)
+                {
+                    uint64_t different = value ? ~bits : bits;
+                    if (remaining < TILE_SIZE)
+                        different &= ((uint64_t) 1 << remaining) - 1;
+                    if (different == 0)
+                    {
+                        run += (uint64_t) remaining;
+                        break;
+                    }
+                    int same = count_trailing_zeros(different);
+                    encode_run(&e, &models, p, value, run + (uint64_t) same);
+                    value = !value, run = 0;
+                    bits >>= same, remaining -= same;
+                }
             }
         }
-        for (int i = 0; i < 6; i++)
+        encode_run(&e, &models, p, value, run);
+    }
+    flush_range_encoder(&e);
+    return;
+}
+
+/*********************************************************************************************
+ * initialize_run_models:    Purpose: Sets every probability in the run models to one half.  *
+ *                           Parameters: Run_Models *models -> the models to initialize      *
+ *                           Return value: none                                              *
+ *                           Side effects: - Edits the models.                               *
+ *********************************************************************************************/
+void initialize_run_models(Run_Models *models)
+{
+    for (int p = 0; p < 3; p++)
+    {
+        models->first_bit[p] = RANGE_MODEL_ONE / 2;
+        for (int v = 0; v < 2; v++)
         {
-            fwrite_return = fwrite(buffer8n1[i], sizeof(uint8_t), 1, savefile);
-            if (fwrite_return != 1)
+            for (int i = 0; i < RUN_LENGTH_SLOTS; i++)
             {
-                error_code = 27;
-                fclose_return = fclose(savefile);
-                if (fclose_return == EOF)
-                    error_code = 29;
-                return;
+                models->length_bits[p][v][i] = RANGE_MODEL_ONE / 2;
+                for (int j = 0; j < 1 << RUN_MODELED_MANTISSA_BITS; j++)
+                    models->mantissa[p][v][i][j] = RANGE_MODEL_ONE / 2;
             }
         }
+    }
+    return;
+}
 
-        current_room = current_room->next_room;
+/*********************************************************************************************
+ * encode_run, decode_run:    Purpose: Write/read one run length (at least 1). The number of *
+ *                                     its significant bits is coded through a bit tree, its *
+ *                                     next few bits through a second tree chosen by that    *
+ *                                     number, and any lower bits directly (at 1 bit each).  *
+ *                                     Every model is specific to the plane and run value.   *
+ *                            Parameters: Range_Encoder *e / Range_Decoder *d -> the coder   *
+ *                                        Run_Models *models -> the adaptive models          *
+ *                                        int plane -> which plane (0-2) the run is in       *
+ *                                        int value -> the value of the run's bits           *
+ *                                        uint64_t length -> (encode_run only) the length    *
+ *                            Return value: (decode_run only) uint64_t -> the length read    *
+ *                            Side effects: - Writes/reads coded bytes.                      *
+ *                                          - Edits the models.                              *
+ *********************************************************************************************/
+void encode_run(Range_Encoder *e, Run_Models *models, int plane, int value, uint64_t length)
+{
+    int significant_bits = 64 - count_leading_zeros(length);
+    int slot = significant_bits - 1;
+    for (int i = RUN_LENGTH_SLOT_BITS - 1, node = 1; i >= 0; i--)
+    {
+        int bit = (slot >> i) & 1;
+        encode_bit(e, &models->length_bits[plane][value][node], bit);
+        node = node * 2 + bit;
     }
 
-    // display height = int32_t
-    // display width = int32_t
-    // display y_offset = int32_t
-    // display x_offset = int32_t
-    int32_t buffer32n3[4] = {0};
-    buffer32n3[0] = savable_gamestate->display->height;
-    buffer32n3[1] = savable_gamestate->display->width;
-    buffer32n3[2] = savable_gamestate->display->y_offset;
-    buffer32n3[3] = savable_gamestate->display->x_offset;
+    // The bits below the leading 1:
+    int modeled = slot < RUN_MODELED_MANTISSA_BITS ? slot : RUN_MODELED_MANTISSA_BITS;
+    for (int i = slot - 1, node = 1; i >= slot - modeled; i--)
+    {
+        int bit = (int) (length >> i) & 1;
+        encode_bit(e, &models->mantissa[plane][value][slot][node], bit);
+        node = node * 2 + bit;
+    }
+    encode_direct_bits(e, length, slot - modeled);
+    return;
+}
 
-    for (int i = 0; i < 4; i++)
+uint64_t decode_run(Range_Decoder *d, Run_Models *models, int plane, int value)
+{
+    int slot = 0;
+    for (int i = 0, node = 1; i < RUN_LENGTH_SLOT_BITS; i++)
+    {
+        int bit = decode_bit(d, &models->length_bits[plane][value][node]);
+        node = node * 2 + bit;
+        slot = slot * 2 + bit;
+    }
+
+    uint64_t length = 1;
+    int modeled = slot < RUN_MODELED_MANTISSA_BITS ? slot : RUN_MODELED_MANTISSA_BITS;
+    for (int i = 0, node = 1; i < modeled; i++)
+    {
+        int bit = decode_bit(d, &models->mantissa[plane][value][slot][node]);
+        node = node * 2 + bit;
+        length = length * 2 + (uint64_t) bit;
+    }
+    for (int i = modeled; i < slot; i++)
+        length = length * 2 + (uint64_t) decode_direct_bit(d);
+    return length;
+}
+
+/*********************************************************************************************
+ * encode_bit, encode_direct_bits, shift_low, flush_range_encoder:                           *
+ *               Purpose: A binary range coder (in the style of LZMA's). encode_bit codes a  *
+ *                        bit with an adaptive probability (of a 0, in RANGE_MODEL_BITS      *
+ *                        bits), which it then nudges towards the bit given; direct bits     *
+ *                        cost exactly one bit each. Bytes whose value may still change      *
+ *                        through a carry are held back (in cache/cache_size) until they     *
+ *                        can't. flush_range_encoder writes out the last of the bytes.       *
+ *               Parameters: Range_Encoder *e -> the encoder                                 *
+ *                           uint16_t *probability -> (encode_bit only) the bit's model      *
+ *                           int bit -> (encode_bit only) the bit to code                    *
+ *                           uint64_t bits, int count -> (encode_direct_bits only) the low   *
+ *                                                       count bits of bits, highest first   *
+ *               Return value: none                                                          *
+ *               Side effects: - Writes coded bytes to the encoder's save buffer.            *
+ *                             - (encode_bit only) Edits the model.                          *
+ *********************************************************************************************/
+void encode_bit(Range_Encoder *e, uint16_t *probability, int bit)
+{
+    uint32_t bound = (e->range >> RANGE_MODEL_BITS) * *probability;
+    if (bit == 0)
+    {
+        e->range = bound;
+        *probability += (RANGE_MODEL_ONE - *probability) >> RANGE_MOVE_BITS;
+    }
+    else
+    {
+        e->low += bound;
+        e->range -= bound;
+        *probability -= *probability >> RANGE_MOVE_BITS;
+    }
+    while (e->range < RANGE_TOP)
+        e->range <<= 8, shift_low(e);
+    return;
+}
+
+void encode_direct_bits(Range_Encoder *e, uint64_t bits, int count)
+{
+    while (count-- > 0)
+    {
+        e->range >>= 1;
+        if ((bits >> count) & 1)
+            e->low += e->range;
+        while (e->range < RANGE_TOP)
+            e->range <<= 8, shift_low(e);
+    }
+    return;
+}
+
+void shift_low(Range_Encoder *e)
+{
+    if ((uint32_t) e->low < 0xFF000000u || (e->low >> 32) != 0)
+    {
+        unsigned char carry = (unsigned char) (e->low >> 32), byte = e->cache;
+        for (; e->cache_size > 0; e->cache_size--, byte = 0xFF)
+        {
+            byte = (unsigned char) (byte + carry);
+            buffer_bytes(e->b, &byte, 1);
+        }
+        e->cache = (unsigned char) (e->low >> 24);
+    }
+    e->cache_size++;
+    e->low = (e->low & 0x00FFFFFFu) << 8;
+    return;
+}
+
+void flush_range_encoder(Range_Encoder *e)
+{
+    for (int i = 0; i < 5; i++)
+        shift_low(e);
+    return;
+}
+
+/*********************************************************************************************
+ * journal_record, write_varint:                                                             *
+ *               Purpose: Add one record (see enum journal_records) to the current command's *
+ *                        edits / store an unsigned integer as read_varint() reads it.       *
+ *               Parameters: Journal *j -> the journal to record in                          *
+ *                           int type -> the record's type                                   *
+ *                           const uint32_t *values, int count -> the record's values        *
+ *                           unsigned char *bytes -> (write_varint only) where to store it   *
+ *                           uint32_t value -> (write_varint only) the integer to store      *
+ *               Return value: (write_varint only) size_t -> the number of bytes stored      *
+ *               Side effects: - Edits the journal (may allocate memory).                    *
+ *                             - Edits global variable "error_code"                          *
+ *********************************************************************************************/
+void journal_record(Journal *j, int type, const uint32_t *values, int count)
+{
+    size_t needed = j->pending_used + 1 + (size_t) count * MAX_VARINT_SIZE;
+    if (needed > j->pending_capacity)
     {
-        fwrite_return = fwrite(buffer32n3[i], sizeof(int32_t), 1, savefile);
-        if (fwrite_return != 1)
+        size_t capacity = j->pending_capacity > 0 ? j->pending_capacity : 64;
+        while (capacity < needed)
+            capacity *= 2;
+        unsigned char *pending = realloc(j->pending, capacity);
+        if (pending == NULL)
         {
-            error_code = 27;
-            fclose_return = fclose(savefile);
-            if (fclose_return == EOF)
-                error_code = 29;
+            error_code = 34;
             return;
         }
+        j->pending = pending, j->pending_capacity = capacity;
     }
 
-    // settings movement mode = uint8_t
-    uint8_t buffer8n2 = 0;
-    buffer8n2 = savable_gamestate->user_settings->movement_mode == NESW ? 0 : 1;
+    j->pending[j->pending_used++] = (unsigned char) type;
+    for (int i = 0; i < count; i++)
+        j->pending_used += write_varint(j->pending + j->pending_used, values[i]);
+    return;
+}
+
+size_t write_varint(unsigned char *bytes, uint32_t value)
+{
+    size_t count = 0;
+    for (; value >= 0x80; value >>= 7)
+        bytes[count++] = (unsigned char) (value | 0x80);
+    bytes[count++] = (unsigned char) value;
+    return count;
+}
+
+/*********************************************************************************************
+ * journal_view, remember_journal_view:                                                      *
+ *               Purpose: Record whichever of the cursor, marks, display and settings have   *
+ *                        changed since they were last recorded / take the current ones as   *
+ *                        recorded (as when the journal starts over).                        *
+ *               Parameters: Gamestate *g -> the gamestate whose view to record              *
+ *               Return value: none                                                          *
+ *               Side effects: - Edits the gamestate's journal.                              *
+ *                             - (journal_view only) Edits global variable "error_code"      *
+ *********************************************************************************************/
+void journal_view(Gamestate *g)
+{
+    Journal *j = &g->journal;
+    Coordinates cursor = g->current_cursor_focus;
+    Display *d = g->display;
+    Settings *s = g->user_settings;
+    if (!same_room(cursor, j->cursor))
+        journal_record(j, JOURNAL_CURSOR, (uint32_t []) {(uint32_t) cursor.y_coordinate, (uint32_t) cursor.x_coordinate}, 2);
+    if (!same_room(g->start, j->start) || !same_room(g->end, j->end))
+        journal_record(j, JOURNAL_MARKS, (uint32_t []) {(uint32_t) (g->start.y_coordinate + 1), (uint32_t) (g->start.x_coordinate + 1), (uint32_t) (g->end.y_coordinate + 1), (uint32_t) (g->end.x_coordinate + 1)}, 4);
+    if (d->height != j->display.height || d->width != j->display.width || d->y_offset != j->display.y_offset || d->x_offset != j->display.x_offset)
+        journal_record(j, JOURNAL_DISPLAY, (uint32_t []) {(uint32_t) d->height, (uint32_t) d->width, (uint32_t) d->y_offset, (uint32_t) d->x_offset}, 4);
+    if (s->movement_mode != j->settings.movement_mode || s->max_display_height != j->settings.max_display_height || s->max_display_width != j->settings.max_display_width)
+        journal_record(j, JOURNAL_SETTINGS, (uint32_t []) {s->movement_mode == NESW ? 0 : 1, (uint32_t) s->max_display_height, (uint32_t) s->max_display_width}, 3);
+    remember_journal_view(g);
+    return;
+}
+
+void remember_journal_view(Gamestate *g)
+{
+    Journal *j = &g->journal;
+    j->cursor = g->current_cursor_focus;
+    j->start = g->start, j->end = g->end;
+    j->display = *g->display;
+    j->settings = *g->user_settings;
+    return;
+}
 
-    fwrite_return = fwrite(buffer8n2, sizeof(uint8_t), 1, savefile);
-    if (fwrite_return != 1)
+/*********************************************************************************************
+ * journal_command:    Purpose: Appends the edits made by the command just obeyed to the     *
+ *                              map's journal as one frame (see Journal), flushed to the     *
+ *                              operating system so that they outlive the process. Maps are  *
+ *                              only journaled once they have a name to be recovered under.  *
+ *                              The journal is compacted into a snapshot whenever its frames *
+ *                              outgrow what it starts from.                                 *
+ *                     Parameters: Gamestate *g -> the gamestate after the command           *
+ *                     Return value: none                                                    *
+ *                     Side effects: - Creates/appends to the journal file.                  *
+ *                                   - Edits the gamestate's journal.                        *
+ *                                   - Edits global variable "error_code"                    *
+ *********************************************************************************************/
+void journal_command(Gamestate *g)
+{
+    Journal *j = &g->journal;
+    journal_view(g);
+    if (error_code || j->pending_used == 0)
+        return;
+    if (j->failed || g->current_filename == NULL)
     {
-        error_code = 27;
-        fclose_return = fclose(savefile);
-        if (fclose_return == EOF)
-            error_code = 29;
+        j->pending_used = 0;
+        return;
+    }
+    if (j->file == NULL && !j->based_on_savefile)
+    {
+        compact_journal(g); // (The snapshot holds this command's edits too.)
         return;
     }
 
-    // settings max display height = int32_t
-    // settings max display width = int32_t
-    // gamestate current_cursor_focus y_coordinate = int32_t
-    // gamestate current_cursor_focus x_coordinate = int32_t
-    int32_t buffer32n4[4] = {0};
-    buffer32n4[0] = savable_gamestate->user_settings->max_display_height;
-    buffer32n4[1] = savable_gamestate->user_settings->max_display_width;
-    buffer32n4[2] = savable_gamestate->current_cursor_focus->y_coordinate;
-    buffer32n4[3] = savable_gamestate->current_cursor_focus->x_coordinate;
-
-    for (int i = 0; i < 4; i++)
+    if (j->file == NULL)
     {
-        fwrite_return = fwrite(buffer32n4[i], sizeof(int32_t), 1, savefile);
-        if (fwrite_return != 1)
+        free(j->path);
+        j->path = savefile_path(g->current_filename, JOURNAL_EXTENSION, false);
+        if (j->path == NULL)
+            return;
+        unsigned char header[JOURNAL_HEADER_SIZE] = {0};
+        (void) memcpy(header, JOURNAL_MAGIC, strlen(JOURNAL_MAGIC));
+        write_le16(header + 4, JOURNAL_VERSION);
+        write_le32(header + 8, j->savefile_crc);
+        j->file = fopen(j->path, "wb");
+        if (j->file == NULL || fwrite(header, 1, sizeof(header), j->file) != sizeof(header))
         {
-            error_code = 27;
-            fclose_return = fclose(savefile);
-            if (fclose_return == EOF)
-                error_code = 29;
+            abandon_journal(j);
             return;
         }
     }
 
-    fclose_return = fclose(savefile);
-    if (fclose_return == EOF)
-        error_code = 28;
+    unsigned char frame_length[MAX_VARINT_SIZE], crc[JOURNAL_FRAME_CRC_SIZE];
+    size_t frame_length_size = write_varint(frame_length, (uint32_t) j->pending_used);
+    write_le32(crc, crc32_update(0, j->pending, j->pending_used));
+    if (fwrite(frame_length, 1, frame_length_size, j->file) != frame_length_size || fwrite(j->pending, 1, j->pending_used, j->file) != j->pending_used
+        || fwrite(crc, 1, sizeof(crc), j->file) != sizeof(crc) || fflush(j->file) == EOF)
+    {
+        abandon_journal(j);
+        return;
+    }
+    j->size += frame_length_size + j->pending_used + sizeof(crc);
+    j->pending_used = 0;
+
+    if (j->size > j->base_size && j->size > JOURNAL_MIN_COMPACTION_SIZE)
+        compact_journal(g);
+    return;
+}
+
+/*********************************************************************************************
+ * compact_journal:    Purpose: Starts the journal over from a snapshot of the gamestate as  *
+ *                              it is now, written as a v2 savefile at the start of the      *
+ *                              journal file (replacing the old journal only once complete). *
+ *                              The savefile itself is left alone.                           *
+ *                     Parameters: Gamestate *g -> the gamestate to snapshot                 *
+ *                     Return value: none                                                    *
+ *                     Side effects: - Creates/replaces the journal file.                    *
+ *                                   - Edits the gamestate's journal.                        *
+ *                                   - Edits global variable "error_code"                    *
+ *********************************************************************************************/
+void compact_journal(Gamestate *g)
+{
+    Journal *j = &g->journal;
+    if (j->file != NULL)
+        (void) fclose(j->file), j->file = NULL;
+    char *path = savefile_path(g->current_filename, JOURNAL_EXTENSION, false);
+    char *temporary_path = savefile_path(g->current_filename, JOURNAL_EXTENSION, true);
+    if (path == NULL || temporary_path == NULL)
+    {
+        free(path), free(temporary_path);
+        return;
+    }
+
+    uint32_t unused_crc;
+    uint64_t length = 0;
+    int problem = write_savefile(g, path, temporary_path, false, &unused_crc, &length);
+    free(temporary_path);
+    free(j->path);
+    j->path = path;
+    if (problem == 32)
+        error_code = 32;
+    if (problem)
+    {
+        abandon_journal(j);
+        return;
+    }
+    rebase_journal(g, false, 0, length);
+    j->file = fopen(path, "ab");
+    if (j->file == NULL)
+        abandon_journal(j);
+    return;
+}
+
+/*********************************************************************************************
+ * rebase_journal:    Purpose: Starts the journal over from the savefile just loaded or      *
+ *                             saved, or from a snapshot of its own.                         *
+ *                    Parameters: Gamestate *g -> the gamestate whose journal it is          *
+ *                                bool based_on_savefile -> whether it starts from the       *
+ *                                                          savefile (else from a snapshot)  *
+ *                                uint32_t savefile_crc -> the CRC-32 of the savefile's      *
+ *                                                         header (if based on it)           *
+ *                                uint64_t base_size -> the size of the savefile/snapshot    *
+ *                    Return value: none                                                     *
+ *                    Side effects: - Edits the gamestate's journal.                         *
+ *********************************************************************************************/
+void rebase_journal(Gamestate *g, bool based_on_savefile, uint32_t savefile_crc, uint64_t base_size)
+{
+    Journal *j = &g->journal;
+    j->based_on_savefile = based_on_savefile, j->savefile_crc = savefile_crc;
+    j->base_size = base_size, j->size = 0;
+    j->failed = false;
+    j->pending_used = 0;
+    remember_journal_view(g);
+    return;
+}
+
+/*********************************************************************************************
+ * abandon_journal, discard_journal, close_journal:                                          *
+ *               Purpose: Stop journaling after the journal couldn't be written (whatever    *
+ *                        made it to the file can still be recovered) / delete the journal,  *
+ *                        as when the map is saved or the user quits without saving / close  *
+ *                        the journal and free its memory, leaving the file for recovery.    *
+ *               Parameters: Journal *j -> the journal                                       *
+ *               Return value: none                                                          *
+ *               Side effects: - Closes (discard_journal: deletes) the journal file.         *
+ *                             - Edits the journal (close_journal: frees its memory).        *
+ *********************************************************************************************/
+void abandon_journal(Journal *j)
+{
+    if (j->file != NULL)
+        (void) fclose(j->file), j->file = NULL;
+    j->failed = true;
+    j->pending_used = 0;
+    return;
+}
+
+void discard_journal(Journal *j)
+{
+    if (j->file != NULL)
+        (void) fclose(j->file), j->file = NULL;
+    if (j->path != NULL)
+        (void) remove(j->path);
+    free(j->path);
+    j->path = NULL;
+    j->pending_used = 0;
+    return;
+}
+
+void close_journal(Journal *j)
+{
+    if (j->file != NULL)
+        (void) fclose(j->file), j->file = NULL;
+    free(j->path), free(j->pending);
+    j->path = NULL, j->pending = NULL;
+    j->pending_used = j->pending_capacity = 0;
     return;
 }
 
@@ -3055,32 +5044,23 @@ void save_gamestate(Gamestate *savable_gamestate)
  **********************************************************************************************/
 void free_map(Map *freeable_map)
 {
-    free_rooms(freeable_map->root);
-    free(freeable_map);
-    return;
-}
-
-/*****************************************************************************************************
- * free_rooms:  Purpose: Recursively frees all allocated memory for the given room linked list node. *
- *              Parameters: Room *r -> The node to be recursively freed.                             *
- *              Return value: none                                                                   *
- *              Side effects: - Frees all memory associated with given node. Cannot be undone.       *
- *****************************************************************************************************/
-void free_rooms(Room *r)
-{
-    // Base case:
-    if (r == NULL)
+    if (freeable_map == NULL)
         return;
-
-    // Other cases:
-    free_rooms(r->next_room);
-    free(r);
-
+    // Every tile lives in one of the arena's blocks:
+    while (freeable_map->tile_blocks != NULL)
+    {
+        Tile_Block *next_block = freeable_map->tile_blocks->next_block;
+        free(freeable_map->tile_blocks);
+        freeable_map->tile_blocks = next_block;
+    }
+    free(freeable_map->tiles);
+    free(freeable_map);
     return;
 }
 
 void free_gamestate(Gamestate *g)
 {
+    close_journal(&g->journal);
     free(g->current_filename);
     free(g);
 